@@ -16,15 +16,21 @@
 
 #include "egfullscreenclient.h"
 #include "background_client.h"
+#include "pixel_kernels.h"
+
+#include "single-pixel-buffer-v1-client-protocol.h"
+#include "viewporter-client-protocol.h"
 
 #include "mir/abnormal_exit.h"
 #include "mir/log.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstring>
 #include <codecvt>
 #include <filesystem>
 #include <fstream>
+#include <limits>
 #include <sstream>
 
 #include <boost/throw_exception.hpp>
@@ -46,40 +52,131 @@ auto get_font_path() -> Path
 
     return ubuntu_font;
 }
+
+auto hash_of(std::vector<std::string_view> const& lines) -> size_t
+{
+    size_t hash = lines.size();
+    for (auto const& line : lines)
+    {
+        hash = hash * 31 + std::hash<std::string_view>{}(line);
+    }
+    return hash;
+}
+
+auto to_pixel(Colour const& colour) -> uint32_t
+{
+    // Colour is laid out in memory as the bytes of an ARGB8888 pixel, alpha always opaque
+    unsigned char const bytes[4] = {colour[0], colour[1], colour[2], 0xFF};
+    uint32_t pixel;
+    memcpy(&pixel, bytes, sizeof(pixel));
+    return pixel;
+}
+
+// Fills area of a buffer width pixels wide with colour
+void fill_area(unsigned char* buffer, uint32_t width, geom::Rectangle const& area, Colour const& colour)
+{
+    auto const pixel = to_pixel(colour);
+    auto const pixels = reinterpret_cast<uint32_t*>(buffer);
+
+    for (auto y = area.top(); y < area.bottom(); y += geom::DeltaY{1})
+    {
+        fill_pixels(pixels + y.as_int() * width + area.left().as_int(), area.size.width.as_int(), pixel);
+    }
+}
+
+// The smallest rectangle containing both a and b, ignoring either if it is empty
+auto bounding_rectangle(geom::Rectangle const& a, geom::Rectangle const& b) -> geom::Rectangle
+{
+    if (a.size.width <= geom::Width{} || a.size.height <= geom::Height{})
+        return b;
+
+    if (b.size.width <= geom::Width{} || b.size.height <= geom::Height{})
+        return a;
+
+    auto const left = std::min(a.left(), b.left());
+    auto const top = std::min(a.top(), b.top());
+    auto const right = std::max(a.right(), b.right());
+    auto const bottom = std::max(a.bottom(), b.bottom());
+
+    return {{left, top}, geom::Size{(right - left).as_int(), (bottom - top).as_int()}};
+}
 } // namespace
 
+/// An immutable snapshot of the diagnostic file: the part of it that can be shown, read in one go, and the lines
+/// to show within that
 struct TextRenderer::DiagnosticText
 {
-    auto static from(Path const& path) -> DiagnosticText;
+    static int const max_lines = 150;
+    static int const max_line_length = 250;
+
+    auto static from(Path const& path) -> std::shared_ptr<DiagnosticText const>;
+
+    explicit DiagnosticText(std::string&& content);
 
-    explicit DiagnosticText(std::vector<std::string> && lines) : lines{std::move(lines)} {}
+    DiagnosticText(DiagnosticText const&) = delete;
+    DiagnosticText& operator=(DiagnosticText const&) = delete;
 
-    std::vector<std::string> const lines;
+    std::string const content;
+    std::vector<std::string_view> const lines;  // Within content
+    size_t const content_hash;
+
+private:
+    static auto split_lines(std::string const& content) -> std::vector<std::string_view>;
 };
 
-auto TextRenderer::DiagnosticText::from(Path const& path) -> DiagnosticText
+auto TextRenderer::DiagnosticText::from(Path const& path) -> std::shared_ptr<DiagnosticText const>
 {
-    static const int max_lines = 150;
-    static const int max_line_length = 250;
+    std::ifstream in{path, std::ios::binary};
+    std::string content;
+
+    // Only read the lines (and the start of each) that will be shown: the file may be a log that keeps growing
+    if (auto const buffer = in.rdbuf(); in)
+    {
+        for (int line_count = 0; line_count <= max_lines; ++line_count)
+        {
+            auto c = buffer->sbumpc();
+            if (c == std::char_traits<char>::eof())
+                break;
+
+            for (int length = 0; c != std::char_traits<char>::eof() && c != '\n'; c = buffer->sbumpc())
+            {
+                if (length++ < max_line_length)
+                    content += std::char_traits<char>::to_char_type(c);
+            }
+
+            if (c == '\n')
+                content += '\n';
+        }
+    }
+
+    return std::make_shared<DiagnosticText const>(std::move(content));
+}
 
+TextRenderer::DiagnosticText::DiagnosticText(std::string&& content) :
+    content{std::move(content)},
+    lines{split_lines(this->content)},
+    content_hash{hash_of(lines)}
+{
+}
 
-    std::ifstream in{path};
-    std::vector<std::string> lines;
-    std::string line;
-    for (int line_count = 0; getline(in, line); ++line_count)
+auto TextRenderer::DiagnosticText::split_lines(std::string const& content) -> std::vector<std::string_view>
+{
+    // As getline() would read them: a final newline doesn't start another line
+    std::vector<std::string_view> lines;
+    std::string_view remaining{content};
+    for (int line_count = 0; !remaining.empty(); ++line_count)
     {
         if (line_count > max_lines)
             break;
 
-        if (line.size() > max_line_length)
-        {
-            line.erase(max_line_length);
-        }
+        auto const end = remaining.find('\n');
+        auto line = remaining.substr(0, end);
+        remaining.remove_prefix(end == std::string_view::npos ? remaining.size() : end + 1);
 
-        lines.push_back(std::move(line));
+        lines.push_back(line.substr(0, max_line_length));
     }
 
-    return DiagnosticText{std::move(lines)};
+    return lines;
 }
 
 BackgroundClient::BackgroundClient(miral::MirRunner* runner, WindowManagerObserver* window_manager_observer)
@@ -101,11 +198,25 @@ public:
         Colour const& crash_background_colour,
         Colour const& crash_text_colour,
         std::optional<Path> diagnostic_path,
-        uint diagnostic_delay);
+        uint diagnostic_delay,
+        uint diagnostic_debounce,
+        uint render_threads);
+
+    auto draw_screen(SurfaceInfo& info, bool draws_crash) const -> Frame override;
+
+    /// Diagnostic text laid out on an output
+    struct PlacedText
+    {
+        std::shared_ptr<TextRenderer::TextLayer const> layer;   // Null if no text fits
+        geom::Point top_left;
 
-    void draw_screen(SurfaceInfo& info, bool draws_crash) const override;
+        auto area() const -> geom::Rectangle;
+    };
 
-    void render_text(uint32_t width, uint32_t height, unsigned char* buffer) const;
+    auto layout_text(TextRenderer::DiagnosticText const& diagnostic, uint32_t width, uint32_t height) const -> PlacedText;
+
+    /// The diagnostic file as of the current diagnostic_generation(), reread only when that changes
+    auto diagnostic_text() const -> std::shared_ptr<TextRenderer::DiagnosticText const>;
 
     bool const wallpaper_enabled;
     Colour const& wallpaper_top_colour;
@@ -123,10 +234,14 @@ private:
     const uint y_margin_percent = 5;
 
     std::mutex mutable buffer_mutex;
+
+    std::shared_ptr<TextRenderer::DiagnosticText const> mutable diagnostic_snapshot;
+    uint64_t mutable diagnostic_snapshot_generation = 0;
 };
 
-TextRenderer::TextRenderer(Path font_path)
-    : font_path{font_path}
+TextRenderer::TextRenderer(Path font_path, size_t glyph_cache_budget)
+    : font_path{font_path},
+      glyph_cache_budget{glyph_cache_budget}
 {
     if (auto const error = FT_Init_FreeType(&library))
     {
@@ -260,6 +375,32 @@ void BackgroundClient::set_diagnostic_delay(int delay)
     }
 }
 
+void BackgroundClient::set_diagnostic_debounce(int debounce)
+{
+    if (debounce >= 0)
+    {
+        diagnostic_debounce = debounce;
+    }
+    else
+    {
+        throw(mir::AbnormalExit(
+            "Diagnostic debounce time (" + std::to_string(debounce) + ") must not be negative"));
+    }
+}
+
+void BackgroundClient::set_render_threads(int threads)
+{
+    if (threads >= 0)
+    {
+        render_threads = threads;
+    }
+    else
+    {
+        throw(mir::AbnormalExit(
+            "Background render threads (" + std::to_string(threads) + ") must not be negative"));
+    }
+}
+
 void BackgroundClient::render_background(
     uint32_t width,
     uint32_t height,
@@ -267,26 +408,71 @@ void BackgroundClient::render_background(
     Colour const& bottom_colour,
     Colour const& top_colour)
 {
-    Colour new_pixel;
+    render_background_rows(width, height, buffer, bottom_colour, top_colour, 0, height);
+}
+
+void BackgroundClient::render_background_rows(
+    uint32_t width,
+    uint32_t height,
+    unsigned char* buffer,
+    Colour const& bottom_colour,
+    Colour const& top_colour,
+    uint32_t first_row,
+    uint32_t end_row)
+{
+    end_row = std::min(end_row, height);
+    if (width == 0 || first_row >= end_row)
+        return;
+
+    auto const pixels = reinterpret_cast<uint32_t*>(buffer);
 
-    for (uint32_t current_y = 0; current_y < height; current_y++)
+    if (std::equal(std::begin(top_colour), std::begin(top_colour) + 3, std::begin(bottom_colour)))
     {
-        // Render gradient
-        for (auto i = 0; i < 3; i++)
-        {
-            new_pixel[i] = ((current_y * bottom_colour[i] + (height - current_y) * top_colour[i]) / height);
-        }
-        new_pixel[3] = 0xFF;
+        fill_pixels(pixels + size_t{first_row} * width, size_t{width} * (end_row - first_row), to_pixel(top_colour));
+        return;
+    }
+
+    // Each channel of row y is (y*bottom + (height - y)*top) / height. Rather than divide for every row, we
+    // step the quotient and remainder of that fraction by (bottom - top)/height as y increases.
+    int32_t quotient[3];
+    int32_t remainder[3];
+    int32_t quotient_step[3];
+    int32_t remainder_step[3];
+    auto const divisor = static_cast<int32_t>(height);
+
+    // Floor division, so that the remainder is never negative
+    auto const floor_divide = [divisor](int64_t dividend) -> int32_t { return dividend / divisor - (dividend % divisor < 0); };
 
-        // Copy new_pixel to buffer
-        auto const pixel_size = sizeof(new_pixel);
-        for (auto current_x = buffer; current_x != buffer + pixel_size * width; current_x += pixel_size)
+    for (auto i = 0; i != 3; ++i)
+    {
+        auto const difference = bottom_colour[i] - top_colour[i];
+        auto const start = int64_t{first_row} * difference;
+        quotient[i] = top_colour[i] + floor_divide(start);
+        remainder[i] = start - floor_divide(start) * divisor;
+        quotient_step[i] = floor_divide(difference);
+        remainder_step[i] = difference - quotient_step[i] * divisor;
+    }
+
+    for (uint32_t current_y = first_row; current_y < end_row; current_y++)
+    {
+        Colour const row_colour{
+            static_cast<unsigned char>(quotient[0]),
+            static_cast<unsigned char>(quotient[1]),
+            static_cast<unsigned char>(quotient[2]),
+            0xFF};
+
+        fill_pixels(pixels + size_t{current_y} * width, width, to_pixel(row_colour));
+
+        for (auto i = 0; i != 3; ++i)
         {
-            memcpy(current_x, new_pixel, pixel_size);
+            quotient[i] += quotient_step[i];
+            remainder[i] += remainder_step[i];
+            if (remainder[i] >= divisor)
+            {
+                remainder[i] -= divisor;
+                ++quotient[i];
+            }
         }
-
-        // Move pointer to next pixel
-        buffer += 4*width;
     }
 }
 
@@ -307,7 +493,9 @@ void BackgroundClient::operator()(wl_display* display)
         crash_background_colour,
         crash_text_colour,
         diagnostic_path,
-        diagnostic_delay);
+        diagnostic_delay,
+        diagnostic_debounce,
+        render_threads);
     {
         std::lock_guard<decltype(mutex)> lock{mutex};
         self = client;
@@ -334,8 +522,11 @@ BackgroundClient::Self::Self(
     Colour const& crash_background_colour,
     Colour const& crash_text_colour,
     std::optional<Path> diagnostic_path,
-    uint diagnostic_delay)
-    : FullscreenClient(display, diagnostic_path, diagnostic_delay, runner, window_manager_observer),
+    uint diagnostic_delay,
+    uint diagnostic_debounce,
+    uint render_threads)
+    : FullscreenClient(
+        display, diagnostic_path, diagnostic_delay, diagnostic_debounce, render_threads, window_manager_observer),
       runner{runner},
       wallpaper_enabled{wallpaper_enabled},
       wallpaper_top_colour{wallpaper_top_colour},
@@ -349,14 +540,30 @@ BackgroundClient::Self::Self(
     wl_display_roundtrip(display);
 }
 
-void BackgroundClient::Self::render_text(
-    uint32_t width,
-    uint32_t height,
-    unsigned char* buffer) const
+auto BackgroundClient::Self::PlacedText::area() const -> geom::Rectangle
 {
-    auto size = geom::Size{width, height};
+    if (!layer)
+    {
+        return {};
+    }
 
-    auto const diagnostic = TextRenderer::DiagnosticText::from(diagnostic_path.value());
+    return {top_left + layer->offset, geom::Size{layer->width, layer->rows}};
+}
+
+auto BackgroundClient::Self::diagnostic_text() const -> std::shared_ptr<TextRenderer::DiagnosticText const>
+{
+    if (!diagnostic_snapshot || diagnostic_snapshot_generation != diagnostic_generation())
+    {
+        diagnostic_snapshot = TextRenderer::DiagnosticText::from(diagnostic_path.value());
+        diagnostic_snapshot_generation = diagnostic_generation();
+    }
+
+    return diagnostic_snapshot;
+}
+
+auto BackgroundClient::Self::layout_text(
+    TextRenderer::DiagnosticText const& diagnostic, uint32_t width, uint32_t height) const -> PlacedText
+{
 
     auto const x_margin = uint32_t(width * (x_margin_percent / 100.0));
     auto const y_margin = uint32_t(height * (y_margin_percent / 100.0));
@@ -364,36 +571,32 @@ void BackgroundClient::Self::render_text(
     auto const x_diff = width - x_margin;
     auto const y_diff = height - y_margin;
 
-    auto const max_font_height_by_width = text_renderer.get_max_font_height_by_width(diagnostic, x_diff);
-    auto const max_font_height_by_height = text_renderer.get_max_font_height_by_height(diagnostic, y_diff);
+    auto const height_pixels = text_renderer.get_max_font_height(diagnostic, x_diff, y_diff);
+    if (height_pixels == 0)
+    {
+        return {};
+    }
 
-    auto const height_pixels = std::min(max_font_height_by_width, max_font_height_by_height);
     auto const line_height = height_pixels + (height_pixels / text_renderer.y_kerning);
 
     auto const num_lines = diagnostic.lines.size();
 
     auto const x_offset = (width - text_renderer.get_max_line_width(diagnostic, height_pixels)) / 2;
     auto const y_offset = (height - (num_lines * line_height)) / 2;
-    auto top_left = geom::Point{x_offset, y_offset};
 
-    for (auto const& line : diagnostic.lines)
-    {
-        text_renderer.render(buffer, size, line, top_left, geom::Height{height_pixels}, crash_text_colour);
-        auto const new_top_left = geom::Point{top_left.x, top_left.y.as_int() + line_height};
-        top_left = new_top_left;
-    }
+    return {text_renderer.get_text_layer(diagnostic, height_pixels), geom::Point{x_offset, y_offset}};
 }
 
-void BackgroundClient::Self::draw_screen(SurfaceInfo& info, bool draws_crash) const
+auto BackgroundClient::Self::draw_screen(SurfaceInfo& info, bool draws_crash) const -> Frame
 {
     std::lock_guard lock{buffer_mutex};
 
     // Don't draw diagnostic background if file is empty or font not found
-    bool const have_diagnostic = diagnostic_path && fs::exists(diagnostic_path.value()) && fs::file_size(diagnostic_path.value());
-    bool const should_show_diagnostic = draws_crash && have_diagnostic;
+    auto const diagnostic = draws_crash && diagnostic_path ? diagnostic_text() : nullptr;
+    bool const should_show_diagnostic = diagnostic && !diagnostic->content.empty();
     if (!wallpaper_enabled && !should_show_diagnostic)
     {
-        return;
+        return {};
     }
 
     bool const rotated = info.output->transform & WL_OUTPUT_TRANSFORM_90;
@@ -401,9 +604,54 @@ void BackgroundClient::Self::draw_screen(SurfaceInfo& info, bool draws_crash) co
     auto const height = rotated ? info.output->width : info.output->height;
 
     if (width <= 0 || height <= 0)
-        return;
+        return {};
+
+    SurfaceInfo::ContentKey const content_key{
+        width,
+        height,
+        info.output->transform,
+        info.output->scale_factor,
+        should_show_diagnostic,
+        {
+            to_pixel(should_show_diagnostic ? crash_background_colour : wallpaper_top_colour),
+            to_pixel(should_show_diagnostic ? crash_text_colour : wallpaper_bottom_colour)
+        },
+        should_show_diagnostic ? diagnostic_generation() : 0};
+
+    // The buffer already on screen shows exactly this content
+    if (info.buffer && info.content_key == content_key)
+        return {};
+
+    // Whether key describes the same content as content_key, but for the member given
+    auto const differs_only_in = [&](std::optional<SurfaceInfo::ContentKey> const& key, auto member)
+        {
+            if (!key)
+                return false;
+
+            auto other = *key;
+            other.*member = content_key.*member;
+            return other == content_key;
+        };
+
+    // Only the scale has changed: the buffer on screen is still right, it just needs to be shown at the new scale
+    if (info.buffer && differs_only_in(info.content_key, &SurfaceInfo::ContentKey::scale_factor))
+    {
+        if (!should_show_diagnostic && viewporter)
+        {
+            wp_viewport_set_destination(
+                info.viewport,
+                width / info.output->scale_factor,
+                height / info.output->scale_factor);
+        }
+        else
+        {
+            wl_surface_set_buffer_scale(info.surface, info.output->scale_factor);
+        }
 
-    auto const stride = 4*width;
+        commit_surface(info);
+        info.content_key = content_key;
+        return {};
+    }
 
     if (!info.surface)
     {
@@ -420,38 +668,156 @@ void BackgroundClient::Self::draw_screen(SurfaceInfo& info, bool draws_crash) co
             info.output->output);
     }
 
-    if (info.buffer && info.buffer_size != stride * height)
+    if (!should_show_diagnostic && viewporter)
     {
-        info.reset_buffer();
-    }
+        // The wallpaper only varies vertically, so a buffer one pixel wide (or, for a solid colour, one pixel
+        // high too) scaled to the output by the compositor has the same content as a full size one
+        if (!info.viewport)
+        {
+            info.viewport = wp_viewporter_get_viewport(viewporter, info.surface);
+        }
 
-    if (!info.buffer)
-    {
-        auto const shm_pool = make_shm_pool(stride * height, &info.content_area);
+        bool const solid = std::equal(
+            std::begin(wallpaper_top_colour), std::begin(wallpaper_top_colour) + 3, std::begin(wallpaper_bottom_colour));
 
-        info.buffer = wl_shm_pool_create_buffer(
-            shm_pool.get(),
-            0,
-            width, height, stride,
-            WL_SHM_FORMAT_ARGB8888);
-        info.buffer_size = stride * height;
+        Frame frame;
+
+        if (solid && single_pixel_buffer_manager)
+        {
+            info.reset_buffer();
+            auto const channel = [](unsigned char value) { return value * 0x01010101u; };
+            info.buffer = info.single_pixel_buffer = wp_single_pixel_buffer_manager_v1_create_u32_rgba_buffer(
+                single_pixel_buffer_manager,
+                channel(wallpaper_top_colour[2]),
+                channel(wallpaper_top_colour[1]),
+                channel(wallpaper_top_colour[0]),
+                UINT32_MAX);
+        }
+        else
+        {
+            auto const column_height = solid ? 1 : height;
+            auto const shm_buffer = shm_buffer_for(info, 1, column_height);
+            if (!shm_buffer)
+                return {};
+
+            shm_buffer->content_key = content_key;
+            shm_buffer->foreground = {};
+
+            frame.render.push_back([this, shm_buffer, column_height]
+                {
+                    render_background(
+                        1, column_height, shm_content(*shm_buffer), wallpaper_bottom_colour, wallpaper_top_colour);
+                });
+        }
+
+        frame.present = [this, &info, width, height, content_key]
+            {
+                wl_surface_attach(info.surface, info.buffer, 0, 0);
+                damage_buffer(info, std::nullopt);
+                wl_surface_set_buffer_scale(info.surface, 1);
+                wp_viewport_set_destination(
+                    info.viewport,
+                    width / info.output->scale_factor,
+                    height / info.output->scale_factor);
+
+                commit_surface(info);
+                info.content_key = content_key;
+            };
+
+        return frame;
     }
 
-    auto buffer = static_cast<unsigned char*>(info.content_area);
+    // Only the diagnostic text differs from what the compositor is showing, so only where the text was and is
+    // now needs to be sent again
+    auto const attached = info.attached_shm_buffer();
+    std::optional<geom::Rectangle> const text_on_screen =
+        should_show_diagnostic && attached && differs_only_in(info.content_key, &SurfaceInfo::ContentKey::diagnostic_generation) ?
+        std::optional{attached->foreground} : std::nullopt;
+
+    auto const shm_buffer = shm_buffer_for(info, width, height);
+    if (!shm_buffer)
+        return {};
+
+    // Likewise, only where the text was and is now needs to be redrawn if that is all that differs from what this
+    // buffer last held
+    bool const repaint_text_only = should_show_diagnostic &&
+        differs_only_in(shm_buffer->content_key, &SurfaceInfo::ContentKey::diagnostic_generation);
+
+    shm_buffer->content_key = content_key;
+
+    Frame frame;
+    geom::Size const size{width, height};
 
     if (should_show_diagnostic)
     {
-        render_background(width, height, buffer, crash_background_colour);
-        render_text(width, height, buffer);
+        // Laid out once here, so that every band draws the same text
+        auto const text = layout_text(*diagnostic, width, height);
+        auto const text_area = text.area();
+
+        geom::Rectangle const repaint = repaint_text_only ?
+            bounding_rectangle(shm_buffer->foreground, text_area) :
+            geom::Rectangle{{}, size};
+
+        shm_buffer->foreground = text_area;
+
+        for (auto const& band : render_bands(size))
+        {
+            auto const clip = band.intersection_with(repaint);
+            if (clip.size.width <= geom::Width{} || clip.size.height <= geom::Height{})
+                continue;
+
+            // Runs on a render worker, touching only the rows of this output's buffer within band
+            frame.render.push_back([this, shm_buffer, width, size, text, clip]
+                {
+                    auto const buffer = shm_content(*shm_buffer);
+
+                    fill_area(buffer, width, clip, crash_background_colour);
+                    if (text.layer)
+                    {
+                        TextRenderer::render(buffer, size, *text.layer, text.top_left, crash_text_colour, clip);
+                    }
+                });
+        }
     }
     else
     {
-        render_background(width, height, buffer, wallpaper_bottom_colour, wallpaper_top_colour);
+        shm_buffer->foreground = {};
+
+        for (auto const& band : render_bands(size))
+        {
+            frame.render.push_back([this, shm_buffer, width, height, band]
+                {
+                    render_background_rows(
+                        width,
+                        height,
+                        shm_content(*shm_buffer),
+                        wallpaper_bottom_colour,
+                        wallpaper_top_colour,
+                        band.top().as_int(),
+                        band.bottom().as_int());
+                });
+        }
     }
 
-    wl_surface_attach(info.surface, info.buffer, 0, 0);
-    wl_surface_set_buffer_scale(info.surface, info.output->scale_factor);
-    wl_surface_commit(info.surface);
+    frame.present = [this, &info, shm_buffer, text_on_screen, content_key]
+        {
+            if (info.viewport)
+            {
+                // Unset any destination size left by the wallpaper
+                wp_viewport_set_destination(info.viewport, -1, -1);
+            }
+
+            wl_surface_attach(info.surface, info.buffer, 0, 0);
+            damage_buffer(
+                info,
+                text_on_screen ? std::optional{bounding_rectangle(*text_on_screen, shm_buffer->foreground)} : std::nullopt);
+            wl_surface_set_buffer_scale(info.surface, info.output->scale_factor);
+
+            commit_surface(info);
+            info.content_key = content_key;
+        };
+
+    return frame;
 }
 
 void BackgroundClient::stop()
@@ -470,17 +836,17 @@ inline auto area(geom::Size size) -> size_t
         : 0;
 }
 
-auto TextRenderer::convert_utf8_to_utf32(std::string const& text) -> std::u32string
+auto TextRenderer::convert_utf8_to_utf32(std::string_view text) -> std::u32string
 {
     std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t> converter;
     std::u32string utf32_text;
     try
     {
-        utf32_text = converter.from_bytes(text);
+        utf32_text = converter.from_bytes(text.data(), text.data() + text.size());
     }
     catch(const std::range_error& e)
     {
-        mir::log_warning("Window title %s is not valid UTF-8", text.c_str());
+        mir::log_warning("Window title %.*s is not valid UTF-8", static_cast<int>(text.size()), text.data());
         // fall back to ASCII
         for (char const c : text)
         {
@@ -498,70 +864,98 @@ auto TextRenderer::convert_utf8_to_utf32(std::string const& text) -> std::u32str
     return utf32_text;
 }
 
-void TextRenderer::render(
-    unsigned char* buf,
-    geom::Size buf_size,
-    std::string const& text,
-    geom::Point top_left,
-    geom::Height height_pixels,
-    Colour const& colour) const
+auto TextRenderer::glyph_for(char32_t code_point, uint32_t height_pixels) const -> Glyph const&
 {
-    if (!area(buf_size) || height_pixels <= geom::Height{})
+    GlyphKey const key = (GlyphKey{code_point} << 32) | height_pixels;
+
+    if (auto const cached = glyph_index.find(key); cached != glyph_index.end())
     {
-        return;
+        glyph_cache.splice(glyph_cache.begin(), glyph_cache, cached->second);
+        return cached->second->second;
     }
 
-    std::lock_guard lock{mutex};
+    set_char_size(height_pixels);
+    rasterize_glyph(code_point);
 
-    if (!library || !face)
+    auto const& slot = *face->glyph;
+    auto const& bitmap = slot.bitmap;
+
+    Glyph glyph{
+        std::vector<unsigned char>(size_t{bitmap.width} * bitmap.rows),
+        bitmap.width,
+        bitmap.rows,
+        slot.bitmap_left,
+        slot.bitmap_top,
+        slot.advance};
+
+    for (uint32_t row = 0; row != bitmap.rows; ++row)
     {
-        mir::log_warning("FreeType not initialized");
-        return;
+        memcpy(glyph.coverage.data() + row * bitmap.width, bitmap.buffer + static_cast<int>(row) * bitmap.pitch, bitmap.width);
     }
 
-    try
+    glyph_cache_size += glyph.coverage.size() + sizeof(Glyph);
+    glyph_cache.emplace_front(key, std::move(glyph));
+    glyph_index.emplace(key, glyph_cache.begin());
+
+    // Evict the least recently used glyphs, but never the one we're returning
+    while (glyph_cache_size > glyph_cache_budget && glyph_cache.size() > 1)
     {
-        set_char_size(height_pixels.as_int());
+        auto const& [evicted_key, evicted] = glyph_cache.back();
+        glyph_cache_size -= evicted.coverage.size() + sizeof(Glyph);
+        glyph_index.erase(evicted_key);
+        glyph_cache.pop_back();
     }
-    catch (std::runtime_error const& error)
+
+    return glyph_cache.front().second;
+}
+
+auto TextRenderer::advance_for(char32_t code_point, uint32_t height_pixels) const -> int32_t
+{
+    // Advances are tiny, but a file of random text could still produce an unbounded number of them
+    static size_t const max_cached_advances = 64 * 1024;
+
+    GlyphKey const key = (GlyphKey{code_point} << 32) | height_pixels;
+
+    if (auto const cached = advance_cache.find(key); cached != advance_cache.end())
     {
-        mir::log_warning("%s", error.what());
-        return;
+        return cached->second;
     }
 
-    auto const utf32 = convert_utf8_to_utf32(text);
+    set_char_size(height_pixels);
+
+    auto const glyph_index = FT_Get_Char_Index(face, code_point);
 
-    for (char32_t const glyph : utf32)
+    // With the default load flags this is the hinted advance, in 16.16 format
+    FT_Fixed advance;
+    if (auto const error = FT_Get_Advance(face, glyph_index, FT_LOAD_DEFAULT, &advance))
     {
-        try
-        {
-            rasterize_glyph(glyph);
-
-            geom::Point glyph_top_left =
-                top_left +
-                geom::Displacement{
-                    face->glyph->bitmap_left,
-                    height_pixels.as_int() - face->glyph->bitmap_top};
-            render_glyph(buf, buf_size, &face->glyph->bitmap, glyph_top_left, colour);
-
-            top_left += geom::Displacement{
-                face->glyph->advance.x / 64,
-                face->glyph->advance.y / 64};
-        }
-        catch (std::runtime_error const& error)
-        {
-            mir::log_warning("%s", error.what());
-        }
+        BOOST_THROW_EXCEPTION(std::runtime_error(
+            "Failed to load metrics for glyph " + std::to_string(glyph_index)));
     }
+
+    if (advance_cache.size() >= max_cached_advances)
+    {
+        advance_cache.clear();
+    }
+
+    return advance_cache[key] = static_cast<int32_t>(advance >> 16);
 }
 
 void TextRenderer::set_char_size(uint32_t height) const
 {
+    if (char_size == height)
+    {
+        return;
+    }
+
     if (auto const error = FT_Set_Pixel_Sizes(face, 0, height))
     {
+        char_size.reset();
         BOOST_THROW_EXCEPTION(std::runtime_error(
             "Setting char size failed with error " + std::to_string(error)));
     }
+
+    char_size = height;
 }
 
 void TextRenderer::rasterize_glyph(char32_t glyph) const
@@ -581,57 +975,182 @@ void TextRenderer::rasterize_glyph(char32_t glyph) const
     }
 }
 
-void TextRenderer::render_glyph(
+void TextRenderer::render_coverage(
     unsigned char* buffer,
     geom::Size buf_size,
-    FT_Bitmap const* glyph,
+    unsigned char const* coverage,
+    uint32_t width,
+    uint32_t rows,
     geom::Point top_left,
-    Colour const& colour) const
+    Colour const& colour,
+    geom::Rectangle const& clip)
 {
-    geom::X const buffer_left = std::max(top_left.x, geom::X{});
-    geom::X const buffer_right = std::min(top_left.x + geom::DeltaX{glyph->width}, as_x(buf_size.width));
+    geom::X const buffer_left = std::max({top_left.x, clip.left(), geom::X{}});
+    geom::X const buffer_right = std::min({top_left.x + geom::DeltaX{width}, clip.right(), as_x(buf_size.width)});
+
+    geom::Y const buffer_top = std::max({top_left.y, clip.top(), geom::Y{}});
+    geom::Y const buffer_bottom = std::min({top_left.y + geom::DeltaY{rows}, clip.bottom(), as_y(buf_size.height)});
 
-    geom::Y const buffer_top = std::max(top_left.y, geom::Y{});
-    geom::Y const buffer_bottom = std::min(top_left.y + geom::DeltaY{glyph->rows}, as_y(buf_size.height));
+    if (buffer_left >= buffer_right)
+    {
+        return;
+    }
 
-    geom::Displacement const glyph_offset = as_displacement(top_left);
+    geom::Displacement const coverage_offset = as_displacement(top_left);
+    auto const span = (buffer_right - buffer_left).as_int();
 
-    auto const colour_alpha = colour[3];
+    uint32_t colour_pixel;
+    memcpy(&colour_pixel, colour, sizeof(colour_pixel));
 
     auto buffer_pixels = reinterpret_cast<uint32_t*>(buffer);
 
     for (geom::Y buffer_y = buffer_top; buffer_y < buffer_bottom; buffer_y += geom::DeltaY{1})
     {
-        geom::Y const glyph_y = buffer_y - glyph_offset.dy;
-        unsigned char const* const glyph_row = glyph->buffer + glyph_y.as_int() * glyph->pitch;
+        geom::Y const coverage_y = buffer_y - coverage_offset.dy;
+        geom::X const coverage_x = buffer_left - coverage_offset.dx;
+        unsigned char const* const coverage_row = coverage + coverage_y.as_int() * width;
         uint32_t* const buffer_row = buffer_pixels + buffer_y.as_int() * buf_size.width.as_int();
 
-        for (geom::X buffer_x = buffer_left; buffer_x < buffer_right; buffer_x += geom::DeltaX{1})
+        blend_coverage(buffer_row + buffer_left.as_int(), coverage_row + coverage_x.as_int(), span, colour_pixel);
+    }
+}
+
+auto TextRenderer::get_text_layer(DiagnosticText const& diagnostic, uint32_t height_pixels) const
+    -> std::shared_ptr<TextLayer const>
+{
+    static size_t const max_text_layers = 4;
+
+    std::lock_guard lock{mutex};
+
+    auto const key = std::make_pair(diagnostic.content_hash, height_pixels);
+    if (auto const cached = text_layers.find(key); cached != text_layers.end())
+    {
+        return cached->second;
+    }
+
+    auto layer = std::make_shared<TextLayer>(TextLayer{{}, 0, 0, {}});
+
+    if (!library || !face)
+    {
+        mir::log_warning("FreeType not initialized");
+        return layer;
+    }
+
+    // Lay the text out as render_text() always has, noting where each visible glyph goes and the bounds of them all
+    struct PlacedGlyph
+    {
+        char32_t code_point;
+        geom::Point top_left;
+    };
+    std::vector<PlacedGlyph> placed_glyphs;
+
+    auto left = std::numeric_limits<int>::max();
+    auto top = std::numeric_limits<int>::max();
+    auto right = std::numeric_limits<int>::min();
+    auto bottom = std::numeric_limits<int>::min();
+
+    auto const line_height = height_pixels + (height_pixels / y_kerning);
+    geom::Point line_top_left;
+
+    for (auto const& line : diagnostic.lines)
+    {
+        auto pen = line_top_left;
+
+        for (char32_t const code_point : convert_utf8_to_utf32(line))
         {
-            geom::X const glyph_x = buffer_x - glyph_offset.dx;
-            unsigned char const glyph_alpha = (static_cast<unsigned char>(glyph_row[glyph_x.as_int()]) * colour_alpha) / 255;
-            auto* const buffer_pixels = reinterpret_cast<unsigned char*>(buffer_row + buffer_x.as_int());
-            for (int i = 0; i < 3; i++)
+            try
             {
-                // Blend colour with the previous buffer colour based on the glyph's alpha
-                buffer_pixels[i] =
-                    (buffer_pixels[i] * (255 - glyph_alpha)) / 255 +
-                    (colour[i] * glyph_alpha) / 255;
+                auto const& glyph = glyph_for(code_point, height_pixels);
+
+                geom::Point const glyph_top_left =
+                    pen + geom::Displacement{glyph.left, static_cast<int>(height_pixels) - glyph.top};
+
+                if (glyph.width && glyph.rows)
+                {
+                    placed_glyphs.push_back({code_point, glyph_top_left});
+                    left = std::min(left, glyph_top_left.x.as_int());
+                    top = std::min(top, glyph_top_left.y.as_int());
+                    right = std::max(right, glyph_top_left.x.as_int() + static_cast<int>(glyph.width));
+                    bottom = std::max(bottom, glyph_top_left.y.as_int() + static_cast<int>(glyph.rows));
+                }
+
+                pen += geom::Displacement{glyph.advance.x / 64, glyph.advance.y / 64};
+            }
+            catch (std::runtime_error const& error)
+            {
+                mir::log_warning("%s", error.what());
             }
         }
+
+        line_top_left += geom::Displacement{0, line_height};
+    }
+
+    if (!placed_glyphs.empty())
+    {
+        layer->width = right - left;
+        layer->rows = bottom - top;
+        layer->offset = geom::Displacement{left, top};
+        layer->coverage.resize(size_t{layer->width} * layer->rows);
+    }
+
+    for (auto const& [code_point, glyph_top_left] : placed_glyphs)
+    {
+        try
+        {
+            auto const& glyph = glyph_for(code_point, height_pixels);
+            auto const x = glyph_top_left.x.as_int() - left;
+            auto const y = glyph_top_left.y.as_int() - top;
+
+            for (uint32_t row = 0; row != glyph.rows; ++row)
+            {
+                auto const* const source = glyph.coverage.data() + row * glyph.width;
+                auto* const dest = layer->coverage.data() + (y + row) * layer->width + x;
+
+                for (uint32_t column = 0; column != glyph.width; ++column)
+                {
+                    // Where glyphs overlap, combine them as blending one after the other would
+                    dest[column] = dest[column] + source[column] - (dest[column] * source[column]) / 255;
+                }
+            }
+        }
+        catch (std::runtime_error const& error)
+        {
+            mir::log_warning("%s", error.what());
+        }
+    }
+
+    // Layers for text that has since changed won't be asked for again. Otherwise there's one per distinct font size
+    // in use, which is one per distinct output size at most.
+    std::erase_if(text_layers, [&](auto const& entry) { return entry.first.first != diagnostic.content_hash; });
+    if (text_layers.size() >= max_text_layers)
+    {
+        text_layers.clear();
     }
+    text_layers.emplace(key, layer);
+
+    return layer;
 }
 
-auto TextRenderer::get_line_width(std::string const& line, uint32_t height_pixels) const -> uint32_t
+void TextRenderer::render(
+    unsigned char* buf,
+    geom::Size buf_size,
+    TextLayer const& layer,
+    geom::Point top_left,
+    Colour const& colour,
+    geom::Rectangle const& clip)
 {
-    set_char_size(height_pixels);
+    render_coverage(
+        buf, buf_size, layer.coverage.data(), layer.width, layer.rows, top_left + layer.offset, colour, clip);
+}
+
+auto TextRenderer::get_line_width(std::string_view line, uint32_t height_pixels) const -> uint32_t
+{
+    std::lock_guard lock{mutex};
 
     auto line_width = 0;
     for (auto const& character : convert_utf8_to_utf32(line))
     {
-        rasterize_glyph(character);
-        auto const glyph = face->glyph;
-        line_width = line_width + (glyph->advance.x >> 6);
+        line_width = line_width + advance_for(character, height_pixels);
     }
 
     return line_width;
@@ -649,23 +1168,60 @@ auto TextRenderer::get_max_line_width(DiagnosticText const& diagnostic, uint32_t
     return max_line_width;
 }
 
-auto TextRenderer::get_max_font_height_by_width(DiagnosticText const& diagnostic, uint32_t max_width) const -> uint32_t
+auto TextRenderer::get_max_font_height(
+    DiagnosticText const& diagnostic,
+    uint32_t max_width,
+    uint32_t max_height) const -> uint32_t
 {
-    auto estimate_font_height = 50;
-    auto const width_from_estimate = get_max_line_width(diagnostic, estimate_font_height);
+    static int const max_iterations = 32;
+    static size_t const max_memoized = 64;
 
-    auto const final_font_height = uint32_t(estimate_font_height * (static_cast<double>(max_width) / width_from_estimate));
-    return final_font_height;
-}
+    auto const num_lines = diagnostic.lines.size();
+    if (num_lines == 0 || max_width == 0 || max_height == 0)
+    {
+        return 0;
+    }
 
-auto TextRenderer::get_max_font_height_by_height(DiagnosticText const& diagnostic, uint32_t max_height) const -> uint32_t
-{
-    auto num_lines = diagnostic.lines.size();
-    auto estimate_font_height = 50;
-    auto const height_from_estimate = get_total_height(num_lines, estimate_font_height);
+    auto const key = std::make_tuple(diagnostic.content_hash, max_width, max_height);
+    {
+        std::lock_guard lock{mutex};
+        if (auto const memoized = font_height_memo.find(key); memoized != font_height_memo.end())
+        {
+            return memoized->second;
+        }
+    }
+
+    auto const fits = [&](uint32_t height_pixels)
+        {
+            return get_total_height(num_lines, height_pixels) <= max_height
+                && get_max_line_width(diagnostic, height_pixels) <= max_width;
+        };
+
+    // The answer is always in [low, high]: "low" fits (or is zero) and each line is at least height_pixels high
+    uint32_t low = 0;
+    uint32_t high = max_height / num_lines;
+
+    for (auto i = 0; i != max_iterations && low < high; ++i)
+    {
+        auto const middle = low + (high - low + 1) / 2;
+        if (fits(middle))
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle - 1;
+        }
+    }
+
+    std::lock_guard lock{mutex};
+    if (font_height_memo.size() >= max_memoized)
+    {
+        font_height_memo.clear();
+    }
+    font_height_memo[key] = low;
 
-    auto const final_font_height = uint32_t(estimate_font_height * (static_cast<double>(max_height) / height_from_estimate));
-    return final_font_height;
+    return low;
 }
 
 auto TextRenderer::get_total_height(uint32_t num_lines, uint32_t height_pixels) const -> uint32_t
@@ -18,16 +18,23 @@
 #define FRAME_BACKGROUND_CLIENT
 
 #include <filesystem>
+#include <list>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
 
 #include <miral/application.h>
 #include <mir/geometry/rectangles.h>
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include FT_ADVANCES_H
 
 struct wl_display;
 
@@ -50,6 +57,8 @@ public:
     void set_crash_text_colour(std::string const& option);
     void set_diagnostic_path(std::string const& option);
     void set_diagnostic_delay(int option);
+    void set_diagnostic_debounce(int option);
+    void set_render_threads(int option);
 
     /// Renders background as a gradient from top_colour to bottom_colour
     static void render_background(
@@ -65,6 +74,16 @@ public:
         unsigned char* buffer,
         Colour const& colour);
 
+    /// Renders rows [first_row, end_row) of the gradient, exactly as render_background() would, leaving the others
+    static void render_background_rows(
+        uint32_t width,
+        uint32_t height,
+        unsigned char* buffer,
+        Colour const& bottom_colour,
+        Colour const& top_colour,
+        uint32_t first_row,
+        uint32_t end_row);
+
     void operator()(wl_display* display);
     void operator()(std::weak_ptr<mir::scene::Session> const& session);
 
@@ -83,6 +102,8 @@ private:
     Colour crash_text_colour = {255, 255, 255, 255};
 
     uint diagnostic_delay = 0;
+    uint diagnostic_debounce = 100;             // Milliseconds
+    uint render_threads = 0;                    // Zero for one per core
 
     std::optional<std::filesystem::path> diagnostic_path;
 
@@ -97,21 +118,37 @@ class TextRenderer
 public:
     using Path = std::filesystem::path;
 
-    TextRenderer(Path font_path);
+    /// \param glyph_cache_budget the number of bytes of rasterized glyphs to keep for reuse
+    TextRenderer(Path font_path, size_t glyph_cache_budget = 4 * 1024 * 1024);
     ~TextRenderer();
 
-    void render(
+    struct DiagnosticText;
+
+    /// Diagnostic text laid out at one pixel height and rasterized to coverage, ready to blend in any colour
+    struct TextLayer
+    {
+        std::vector<unsigned char> coverage;
+        uint32_t width;
+        uint32_t rows;
+        /// The position of the coverage's top left relative to the top left of the text
+        geom::Displacement offset;
+    };
+
+    /// The layer for diagnostic at height_pixels, shared with earlier callers asking for the same text and height
+    auto get_text_layer(DiagnosticText const& diagnostic, uint32_t height_pixels) const
+        -> std::shared_ptr<TextLayer const>;
+
+    /// Blends layer onto buf in colour, with the top left of the text at top_left, leaving buf outside clip untouched
+    static void render(
         unsigned char* buf,
         geom::Size buf_size,
-        std::string const& text,
+        TextLayer const& layer,
         geom::Point top_left,
-        geom::Height height_pixels,
-        Colour const& colour) const;
-
-    struct DiagnosticText;
+        Colour const& colour,
+        geom::Rectangle const& clip);
 
-    auto get_max_font_height_by_width(DiagnosticText const& diagnostic, uint32_t max_width) const -> uint32_t;
-    auto get_max_font_height_by_height(DiagnosticText const& diagnostic, uint32_t max_height) const -> uint32_t;
+    /// The largest pixel height at which all of diagnostic fits within max_width by max_height (or zero if none does)
+    auto get_max_font_height(DiagnosticText const& diagnostic, uint32_t max_width, uint32_t max_height) const -> uint32_t;
     auto get_max_line_width(DiagnosticText const& diagnostic, uint32_t height_pixels) const -> uint32_t;
 
     uint const y_kerning = 5;
@@ -124,19 +161,58 @@ private:
 
     std::mutex mutable mutex;
 
+    /// A rasterized glyph, with its coverage stored without padding (pitch == width)
+    struct Glyph
+    {
+        std::vector<unsigned char> coverage;
+        uint32_t width;
+        uint32_t rows;
+        int32_t left;
+        int32_t top;
+        FT_Vector advance;
+    };
+
+    /// Most recently used glyphs first, keyed by (code point, pixel height)
+    using GlyphKey = uint64_t;
+    std::list<std::pair<GlyphKey, Glyph>> mutable glyph_cache;
+    std::unordered_map<GlyphKey, decltype(glyph_cache)::iterator> mutable glyph_index;
+    size_t mutable glyph_cache_size = 0;
+    size_t const glyph_cache_budget;
+    std::optional<uint32_t> mutable char_size;
+
+    /// Requires mutex to be held. The result is valid until the next call.
+    auto glyph_for(char32_t code_point, uint32_t height_pixels) const -> Glyph const&;
+
+    /// Hinted horizontal advances in whole pixels, keyed like the glyph cache
+    std::unordered_map<GlyphKey, int32_t> mutable advance_cache;
+
+    /// Measures a glyph from its metrics alone, without rasterizing it. Requires mutex to be held.
+    auto advance_for(char32_t code_point, uint32_t height_pixels) const -> int32_t;
+
+    /// get_max_font_height() results keyed by (content hash, max width, max height)
+    std::map<std::tuple<size_t, uint32_t, uint32_t>, uint32_t> mutable font_height_memo;
+
+    /// Text layers keyed by (content hash, pixel height)
+    std::map<std::pair<size_t, uint32_t>, std::shared_ptr<TextLayer const>> mutable text_layers;
+
     void set_char_size(uint32_t height) const;
     void rasterize_glyph(char32_t glyph) const;
-    void render_glyph(
+
+    /// Blends width by rows of coverage onto buffer in colour, clipped to clip and buf_size
+    static void render_coverage(
         unsigned char* buffer,
         geom::Size buf_size,
-        FT_Bitmap const* glyph,
+        unsigned char const* coverage,
+        uint32_t width,
+        uint32_t rows,
         geom::Point top_left,
-        Colour const& colour) const;
+        Colour const& colour,
+        geom::Rectangle const& clip);
 
     static auto get_font_path() -> std::optional<Path>;
-    static auto convert_utf8_to_utf32(std::string const& text) -> std::u32string;
+    static auto convert_utf8_to_utf32(std::string_view text) -> std::u32string;
 
-    auto get_line_width(std::string const& line, uint32_t height_pixels) const -> uint32_t;
+    auto get_line_width(std::string_view line, uint32_t height_pixels) const -> uint32_t;
     auto get_total_height(uint32_t num_lines, uint32_t height_pixels) const -> uint32_t;
 };
 
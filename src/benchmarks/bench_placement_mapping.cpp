@@ -0,0 +1,161 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "placement_mapping.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+// The pair of vectors PlacementMapping used to be, for comparison
+class VectorPlacementMapping
+{
+public:
+    void update(int output_id, std::optional<std::string> const& title, std::optional<std::string> const& snap_name)
+    {
+        clear(output_id);
+
+        if (title)
+            surface_title_to_output_id.emplace_back(*title, output_id);
+
+        if (snap_name)
+            snap_name_to_output_id.emplace_back(*snap_name, output_id);
+    }
+
+    void clear(int output_id)
+    {
+        auto const claimed = [output_id](auto const& e) { return e.second == output_id; };
+
+        surface_title_to_output_id.erase(
+            std::remove_if(begin(surface_title_to_output_id), end(surface_title_to_output_id), claimed),
+            end(surface_title_to_output_id));
+
+        snap_name_to_output_id.erase(
+            std::remove_if(begin(snap_name_to_output_id), end(snap_name_to_output_id), claimed),
+            end(snap_name_to_output_id));
+    }
+
+    auto output_for_surface(std::string_view title) const -> std::optional<int>
+    {
+        for (auto const& t2o : surface_title_to_output_id)
+        {
+            if (t2o.first == title)
+                return t2o.second;
+        }
+        return std::nullopt;
+    }
+
+    auto output_for_snap(std::string_view name) const -> std::optional<int>
+    {
+        for (auto const& s2o : snap_name_to_output_id)
+        {
+            if (s2o.first == name)
+                return s2o.second;
+        }
+        return std::nullopt;
+    }
+
+private:
+    std::vector<std::pair<std::string, int>> surface_title_to_output_id;
+    std::vector<std::pair<std::string, int>> snap_name_to_output_id;
+};
+
+auto title_of(int output) -> std::string
+{
+    return "video-wall-tile-" + std::to_string(output);
+}
+
+auto snap_of(int output) -> std::string
+{
+    return "video-wall-player-" + std::to_string(output);
+}
+
+// Configures outputs, then places a window (a title lookup falling back to a snap lookup, as
+// FrameWindowManagerPolicy::assign_to_output() does) per output and finally reconfigures and removes each output
+template<typename Mapping>
+auto time_per_round(int outputs, int iterations) -> double
+{
+    std::vector<std::string> titles;
+    std::vector<std::string> snaps;
+    for (auto i = 0; i != outputs; ++i)
+    {
+        titles.push_back(title_of(i));
+        snaps.push_back(snap_of(i));
+    }
+
+    long found = 0;
+    auto const start = std::chrono::steady_clock::now();
+    for (auto n = 0; n != iterations; ++n)
+    {
+        Mapping mapping;
+        for (auto i = 0; i != outputs; ++i)
+        {
+            mapping.update(i, titles[i], snaps[i]);
+        }
+
+        for (auto i = 0; i != outputs; ++i)
+        {
+            // Half the windows are placed by snap name
+            auto output = mapping.output_for_surface(i % 2 ? titles[i] : "untitled");
+            if (!output)
+                output = mapping.output_for_snap(snaps[i]);
+            found += output.value_or(0);
+        }
+
+        for (auto i = 0; i != outputs; ++i)
+        {
+            mapping.update(i, titles[outputs - 1 - i], std::nullopt);
+        }
+
+        for (auto i = 0; i != outputs; ++i)
+        {
+            mapping.clear(i);
+        }
+    }
+    std::chrono::duration<double, std::milli> const elapsed = std::chrono::steady_clock::now() - start;
+
+    // Keep the lookups from being optimized away
+    if (found < 0)
+        printf("unreachable\n");
+
+    return elapsed.count() / iterations;
+}
+}
+
+int main()
+{
+    struct { int outputs; int iterations; } const sizes[] = {
+        {4, 20000},
+        {64, 2000},
+        {256, 200},
+        {1024, 20},
+    };
+
+    printf("%-8s %12s %12s %8s\n", "outputs", "old (ms)", "new (ms)", "speedup");
+
+    for (auto const& size : sizes)
+    {
+        auto const old_round = time_per_round<VectorPlacementMapping>(size.outputs, size.iterations);
+        auto const new_round = time_per_round<egmde::PlacementMapping>(size.outputs, size.iterations);
+        printf("%-8d %12.3f %12.3f %7.1fx\n", size.outputs, old_round, new_round, old_round / new_round);
+    }
+}
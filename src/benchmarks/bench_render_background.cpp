@@ -0,0 +1,107 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "background_client.h"
+#include "pixel_kernels.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+// The per-pixel memcpy implementation render_background() used to have, for comparison
+void render_background_per_pixel(
+    uint32_t width,
+    uint32_t height,
+    unsigned char* buffer,
+    Colour const& bottom_colour,
+    Colour const& top_colour)
+{
+    Colour new_pixel;
+
+    for (uint32_t current_y = 0; current_y < height; current_y++)
+    {
+        for (auto i = 0; i < 3; i++)
+        {
+            new_pixel[i] = ((current_y * bottom_colour[i] + (height - current_y) * top_colour[i]) / height);
+        }
+        new_pixel[3] = 0xFF;
+
+        auto const pixel_size = sizeof(new_pixel);
+        for (auto current_x = buffer; current_x != buffer + pixel_size * width; current_x += pixel_size)
+        {
+            memcpy(current_x, new_pixel, pixel_size);
+        }
+
+        buffer += 4*width;
+    }
+}
+
+template<typename Render>
+auto time_per_frame(int iterations, Render render) -> double
+{
+    render(); // Warm up: fault in the buffer's pages
+
+    auto const start = std::chrono::steady_clock::now();
+    for (auto i = 0; i != iterations; ++i)
+    {
+        render();
+    }
+    std::chrono::duration<double, std::milli> const elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count() / iterations;
+}
+}
+
+int main()
+{
+    struct { char const* name; uint32_t width; uint32_t height; int iterations; } const resolutions[] = {
+        {"1080p", 1920, 1080, 50},
+        {"4K", 3840, 2160, 20},
+        {"8K", 7680, 4320, 5},
+    };
+
+    Colour const top = {127, 127, 127, 255};
+    Colour const bottom = {31, 31, 31, 255};
+    Colour const solid = {36, 12, 56, 255};
+
+    printf("fill implementation: %s\n", fill_pixels_implementation());
+    printf("%-6s %-9s %12s %12s %8s\n", "size", "content", "old (ms)", "new (ms)", "speedup");
+
+    for (auto const& resolution : resolutions)
+    {
+        std::vector<unsigned char> buffer(4 * size_t{resolution.width} * resolution.height);
+        auto const data = buffer.data();
+        auto const w = resolution.width;
+        auto const h = resolution.height;
+
+        auto const old_gradient = time_per_frame(resolution.iterations,
+            [&]{ render_background_per_pixel(w, h, data, bottom, top); });
+        auto const new_gradient = time_per_frame(resolution.iterations,
+            [&]{ BackgroundClient::render_background(w, h, data, bottom, top); });
+        printf("%-6s %-9s %12.3f %12.3f %7.1fx\n",
+            resolution.name, "gradient", old_gradient, new_gradient, old_gradient / new_gradient);
+
+        auto const old_solid = time_per_frame(resolution.iterations,
+            [&]{ render_background_per_pixel(w, h, data, solid, solid); });
+        auto const new_solid = time_per_frame(resolution.iterations,
+            [&]{ BackgroundClient::render_background(w, h, data, solid); });
+        printf("%-6s %-9s %12.3f %12.3f %7.1fx\n",
+            resolution.name, "solid", old_solid, new_solid, old_solid / new_solid);
+    }
+}
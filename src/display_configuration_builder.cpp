@@ -20,6 +20,14 @@
 
 #include <miral/version.h>
 
+#include <atomic>
+
+namespace
+{
+// Reloads happen on the display configuration's own thread
+std::atomic<unsigned> loads{0};
+}
+
 auto build_display_configuration(miral::MirRunner const& runner)
     -> miral::DisplayConfiguration
 {
@@ -29,7 +37,13 @@ auto build_display_configuration(miral::MirRunner const& runner)
 
     display_config.layout_userdata_builder("applications", [](miral::DisplayConfiguration::Node const& node) -> std::any
     {
+        ++loads;
         return std::make_shared<LayoutMetadata>(node);
     });
     return display_config;
 }
+
+auto display_configuration_loads() -> unsigned
+{
+    return loads;
+}
@@ -27,4 +27,7 @@ class MirRunner;
 auto build_display_configuration(miral::MirRunner const& runner)
     -> miral::DisplayConfiguration;
 
+/// Counts the (re)loads of a layout's "applications" from the display configuration file
+auto display_configuration_loads() -> unsigned;
+
 #endif // FRAME_DISPLAY_CONFIGURATION_BUILDER_H
@@ -19,23 +19,25 @@
 #include "egfullscreenclient.h"
 #include "frame_window_manager.h"
 
+#include "single-pixel-buffer-v1-client-protocol.h"
+#include "viewporter-client-protocol.h"
+
 #include <wayland-client.h>
 
-#include <miral/runner.h>
 #include <mir/log.h>
 
 #include <boost/throw_exception.hpp>
 
-#include <fcntl.h>
+#include <sys/epoll.h>
 #include <sys/eventfd.h>
-#include <sys/mman.h>
-#include <sys/timerfd.h>
 #include <cstdlib>
 #include <climits>
 
+#include <algorithm>
 #include <chrono>
 #include <cstring>
 #include <system_error>
+#include <utility>
 
 void egmde::FullscreenClient::Output::geometry(
     void* data,
@@ -120,6 +122,12 @@ void egmde::FullscreenClient::SurfaceInfo::clear_window()
 {
     reset_buffer();
 
+    if (frame_callback)
+        wl_callback_destroy(frame_callback);
+
+    if (viewport)
+        wp_viewport_destroy(viewport);
+
     if (shell_surface)
         wl_shell_surface_destroy(shell_surface);
 
@@ -127,20 +135,72 @@ void egmde::FullscreenClient::SurfaceInfo::clear_window()
         wl_surface_destroy(surface);
 
 
+    frame_callback = nullptr;
+    frame_pacer.done();
+    viewport = nullptr;
     shell_surface = nullptr;
     surface = nullptr;
 }
 
 void egmde::FullscreenClient::SurfaceInfo::reset_buffer()
 {
-    if (buffer)
+    for (auto& shm_buffer : shm_buffers)
     {
-        wl_buffer_destroy(buffer);
-        if (munmap(content_area, buffer_size))
-            mir::log_error("munmap() failed in %s: %s", __PRETTY_FUNCTION__, strerror(errno));
-        buffer = nullptr;
-        buffer_size = 0;
+        if (shm_buffer.buffer)
+        {
+            // The compositor may still be showing a busy buffer, so its memory can't be reused until it's released
+            if (shm_buffer.busy)
+            {
+                shm_arena->retire(shm_buffer.buffer, shm_buffer.allocation);
+            }
+            else
+            {
+                wl_buffer_destroy(shm_buffer.buffer);
+                shm_arena->free(shm_buffer.allocation);
+            }
+        }
+
+        shm_buffer = ShmBuffer{};
     }
+
+    if (single_pixel_buffer)
+        wl_buffer_destroy(single_pixel_buffer);
+
+    shm_arena = nullptr;
+    shm_width = 0;
+    shm_height = 0;
+    single_pixel_buffer = nullptr;
+    buffer = nullptr;
+    draw_deferred = false;
+
+    content_key.reset();
+}
+
+auto egmde::FullscreenClient::SurfaceInfo::attached_shm_buffer() const -> ShmBuffer const*
+{
+    for (auto const& shm_buffer : shm_buffers)
+    {
+        if (buffer && shm_buffer.buffer == buffer)
+        {
+            return &shm_buffer;
+        }
+    }
+
+    return nullptr;
+}
+
+auto egmde::FullscreenClient::SurfaceInfo::release_shm_buffer(wl_buffer* buffer) -> bool
+{
+    for (auto& shm_buffer : shm_buffers)
+    {
+        if (shm_buffer.buffer == buffer)
+        {
+            shm_buffer.busy = false;
+            return true;
+        }
+    }
+
+    return false;
 }
 
 void egmde::FullscreenClient::Output::done(void* data, struct wl_output* /*wl_output*/)
@@ -149,21 +209,17 @@ void egmde::FullscreenClient::Output::done(void* data, struct wl_output* /*wl_ou
     output->on_done(*output);
 }
 
-egmde::FullscreenClient::FullscreenClient(wl_display* display, std::optional<Path> diagnostic_path, uint diagnostic_delay, miral::MirRunner* runner, WindowManagerObserver* window_manager_observer) :
-    draw_signal{::eventfd(0, EFD_SEMAPHORE)},
+egmde::FullscreenClient::FullscreenClient(wl_display* display, std::optional<Path> diagnostic_path, uint diagnostic_delay, uint diagnostic_debounce, uint render_threads, WindowManagerObserver* window_manager_observer) :
+    draw_signal{::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)},
     shutdown_signal{::eventfd(0, EFD_CLOEXEC)},
-    diagnostic_signal{inotify_init()},
+    diagnostic_signal{inotify_init1(IN_NONBLOCK | IN_CLOEXEC)},
+    render_workers{render_threads ? render_threads - 1 : WorkerPool::default_workers()},
     registry{nullptr, [](auto){}},
     diagnostic_path{diagnostic_path},
     diagnostic_delay{diagnostic_delay},
-    runner{runner},
+    diagnostic_debounce{diagnostic_debounce},
     window_manager_observer{window_manager_observer}
 {
-    fds[display_fd] = {wl_display_get_fd(display), POLLIN, 0};
-    fds[draw_fd]    = {draw_signal,                POLLIN, 0};
-    fds[diagnostic] = {diagnostic_signal,          POLLIN, 0};
-    fds[shutdown]   = {shutdown_signal,            POLLIN, 0};
-
     // Check inotify initializaiton
     if (diagnostic_signal < 0)
     {
@@ -176,7 +232,7 @@ egmde::FullscreenClient::FullscreenClient(wl_display* display, std::optional<Pat
         diagnostic_wd = inotify_add_watch(
             diagnostic_signal,
             diagnostic_path->parent_path().c_str(),
-            IN_CLOSE_WRITE | IN_CREATE | IN_DELETE
+            IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM
         );
 
         diagnostic_exists = true;
@@ -187,6 +243,18 @@ egmde::FullscreenClient::FullscreenClient(wl_display* display, std::optional<Pat
         BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to create shutdown notifier"}));
     }
 
+    // The display is level triggered, as a read may leave events unread. The others are drained by their handlers.
+    reactor.add_fd(wl_display_get_fd(display), EPOLLIN, [this](uint32_t events) { display_ready(events); });
+    reactor.add_fd(draw_signal, EPOLLIN | EPOLLET, [this](uint32_t)
+        {
+            // Reading resets the count, so every request made since the last redraw is handled by this one
+            eventfd_t requests;
+            eventfd_read(draw_signal, &requests);
+            redraw_requested = true;
+        });
+    reactor.add_fd(diagnostic_signal, EPOLLIN | EPOLLET, [this](uint32_t) { read_diagnostic_events(); });
+    reactor.add_fd(shutdown_signal, EPOLLIN, [this](uint32_t) { running = false; });
+
     this->display = display;
 
     registry = {wl_display_get_registry(display), &wl_registry_destroy};
@@ -199,7 +267,12 @@ egmde::FullscreenClient::FullscreenClient(wl_display* display, std::optional<Pat
     wl_registry_add_listener(registry.get(), &registry_listener, this);
 
     set_diagnostic_delay_alarm();
-    window_manager_observer->add_window_opened_callback([this]() { diagnostic_wants_to_draw = false; draw(); });
+    window_manager_observer->add_window_opened_callback([this]()
+        {
+            diagnostic_delay_timer.disarm();
+            diagnostic_wants_to_draw = false;
+            draw(RedrawTarget::diagnostic_outputs);
+        });
     window_manager_observer->add_window_closed_callback([this]() { set_diagnostic_delay_alarm(); });
 }
 
@@ -213,10 +286,7 @@ void egmde::FullscreenClient::notify_diagnostic_delay_expired()
         diagnostic_wants_to_draw = false;
     }
 
-    // Handle is dropped even if expired since closing a window will restart the delay
-    diagnostic_timer_handle.reset();
-
-    draw();
+    draw(RedrawTarget::diagnostic_outputs);
 }
 
 void egmde::FullscreenClient::set_diagnostic_delay_alarm()
@@ -227,35 +297,8 @@ void egmde::FullscreenClient::set_diagnostic_delay_alarm()
     }
     else
     {
-        auto const timer_fd = timerfd_create(CLOCK_REALTIME, 0);
-
-        if (timer_fd == -1)
-        {
-            BOOST_THROW_EXCEPTION(std::runtime_error(
-                "Initializing diagnostic delay timer failed"));
-        }
-
-        auto const spec = itimerspec
-        {
-            { 0, 0 },               // Timer interval
-            { diagnostic_delay, 0 } // Initial expiration
-        };
-
-        if (timerfd_settime(timer_fd, 0, &spec, NULL) == -1)
-        {
-            BOOST_THROW_EXCEPTION(std::runtime_error(
-                "Setting diagnostic delay timer failed"));
-        }
-
-        if (runner)
-        {
-            diagnostic_timer_handle = runner->register_fd_handler(mir::Fd{timer_fd}, [this](int){ notify_diagnostic_delay_expired(); });
-        }
-        else
-        {
-            BOOST_THROW_EXCEPTION(std::runtime_error(
-                "MirRunner expired before creation of diagnostic delay alarm."));
-        }
+        // Closing a window restarts the delay
+        diagnostic_delay_timer.arm(std::chrono::seconds{diagnostic_delay});
     }
 }
 
@@ -271,7 +314,7 @@ void egmde::FullscreenClient::on_output_changed(Output const* output)
         auto const p = outputs.find(output);
         if (p != end(outputs))
         {
-            draw_screen(p->second, should_draw_crash());
+            draw(p->second);
         }
 
         check_for_exposed_outputs();
@@ -289,7 +332,7 @@ void egmde::FullscreenClient::check_for_exposed_outputs()
         if (!display_area.bounding_rectangle().overlaps(screen_rect))
         {
             display_area.add(screen_rect);
-            draw_screen(outputs.insert({*i, SurfaceInfo{*i}}).first->second, should_draw_crash());
+            draw_screens({&outputs.try_emplace(*i, *i).first->second}, should_draw_crash());
             hidden_outputs.erase(i);
             break;
         }
@@ -306,6 +349,7 @@ void egmde::FullscreenClient::on_output_gone(Output const* output)
         std::lock_guard const lock{outputs_mutex};
 
         outputs.erase(output);
+        move_off_stale_shm_pools();
 
         auto i = begin(hidden_outputs);
         while (i != end(hidden_outputs))
@@ -344,7 +388,7 @@ void egmde::FullscreenClient::on_new_output(Output const* output)
         if (!display_area.bounding_rectangle().overlaps(screen_rect))
         {
             display_area.add(screen_rect);
-            draw_screen(outputs.insert({output, SurfaceInfo{output}}).first->second, should_draw_crash());
+            draw_screens({&outputs.try_emplace(output, output).first->second}, should_draw_crash());
         }
         else
         {
@@ -354,57 +398,283 @@ void egmde::FullscreenClient::on_new_output(Output const* output)
     flush_display();
 }
 
-void egmde::FullscreenClient::draw() const
+auto egmde::FullscreenClient::shm_stats() const -> ShmArena::Stats
+{
+    std::lock_guard const lock{outputs_mutex};
+    return shm_arena ? shm_arena->stats() : ShmArena::Stats{0, 0, 0, 0, 0, 0, 0};
+}
+
+auto egmde::FullscreenClient::diagnostic_generation() const -> uint64_t
 {
+    return diagnostic_changes;
+}
+
+void egmde::FullscreenClient::draw(RedrawTarget target)
+{
+    pending_targets |= 1u << static_cast<unsigned>(target);
     eventfd_write(draw_signal, 1);
 }
 
-auto egmde::FullscreenClient::make_shm_pool(size_t size, void** data) const
--> std::unique_ptr<wl_shm_pool, std::function<void(wl_shm_pool*)>>
+void egmde::FullscreenClient::draw(SurfaceInfo& info)
 {
-    static auto (*open_shm_file)() -> mir::Fd = []
+    info.dirty = true;
+    eventfd_write(draw_signal, 1);
+}
+
+void egmde::FullscreenClient::draw_dirty_outputs()
+{
+    {
+        std::lock_guard const lock{outputs_mutex};
+
+        auto const targets = pending_targets.exchange(0);
+        auto const targeted = [targets](RedrawTarget target)
+            {
+                return (targets & (1u << static_cast<unsigned>(target))) != 0;
+            };
+
+        bool const draws_crash = should_draw_crash();
+        auto const now = FramePacer::Clock::now();
+        std::optional<FramePacer::Clock::duration> next_wait_left;
+        std::vector<SurfaceInfo*> to_draw;
+
+        for (auto& [_, info] : outputs)
+        {
+            bool const shows_diagnostic = draws_crash || (info.content_key && info.content_key->diagnostic);
+
+            if (targeted(RedrawTarget::all_outputs) ||
+                (targeted(RedrawTarget::diagnostic_outputs) && shows_diagnostic))
+            {
+                info.dirty = true;
+            }
+
+            // A surface covered by an app may never be shown, so a resize or diagnostic can't wait on it forever
+            if (info.dirty && info.frame_callback && !info.frame_pacer.waiting(now))
+            {
+                wl_callback_destroy(info.frame_callback);
+                info.frame_callback = nullptr;
+                info.frame_pacer.done();
+            }
+
+            // An output still waiting for its last commit to be shown is drawn when it has been
+            if (info.dirty && !info.frame_callback)
+            {
+                info.dirty = false;
+                to_draw.push_back(&info);
+            }
+            else if (info.dirty)
+            {
+                auto const wait_left = info.frame_pacer.wait_left(now).value();
+                next_wait_left = std::min(next_wait_left.value_or(wait_left), wait_left);
+            }
+        }
+
+        draw_screens(to_draw, draws_crash);
+
+        if (next_wait_left)
+        {
+            frame_callback_timer.arm(std::chrono::ceil<std::chrono::milliseconds>(next_wait_left.value()));
+        }
+    }
+    flush_display();
+}
+
+void egmde::FullscreenClient::draw_screens(std::vector<SurfaceInfo*> const& infos, bool draws_crash)
+{
+    std::vector<Frame> frames;
+    std::vector<std::function<void()>> renders;
+    frames.reserve(infos.size());
+
+    for (auto const info : infos)
+    {
+        auto& frame = frames.emplace_back(draw_screen(*info, draws_crash));
+        std::move(frame.render.begin(), frame.render.end(), std::back_inserter(renders));
+    }
+
+    // Every buffer is taken before any is rendered: taking one may grow the shm arena and move its mapping
+    render_workers.run(renders);
+
+    for (auto const& frame : frames)
+    {
+        if (frame.present)
+        {
+            frame.present();
+        }
+    }
+
+    move_off_stale_shm_pools();
+}
+
+auto egmde::FullscreenClient::render_bands(mir::geometry::Size size) const -> std::vector<mir::geometry::Rectangle>
+{
+    // Below this, the cost of handing a band to another thread outweighs that of rendering it
+    static size_t const min_band_pixels = 256 * 1024;
+
+    auto const width = std::max(size.width.as_int(), 0);
+    auto const height = std::max(size.height.as_int(), 0);
+    auto const max_count = std::min<size_t>(render_workers.concurrency(), std::max(height, 1));
+    auto const count = std::clamp<size_t>(size_t(width) * height / min_band_pixels, 1, max_count);
+
+    std::vector<mir::geometry::Rectangle> bands;
+    bands.reserve(count);
+    for (size_t band = 0; band != count; ++band)
+    {
+        int const top = height * band / count;
+        int const bottom = height * (band + 1) / count;
+        bands.push_back({{0, top}, {width, bottom - top}});
+    }
+    return bands;
+}
+
+void egmde::FullscreenClient::commit_surface(SurfaceInfo& info) const
+{
+    static wl_callback_listener const frame_listener = {
+        [](void* self, wl_callback* callback, uint32_t) { static_cast<FullscreenClient*>(self)->frame_done(callback); },
+    };
+
+    if (!info.frame_callback)
     {
-        static char const* shm_dir;
-        open_shm_file = []{ return mir::Fd{open(shm_dir, O_TMPFILE | O_RDWR | O_EXCL, S_IRWXU)}; };
+        info.frame_callback = wl_surface_frame(info.surface);
+        wl_callback_add_listener(info.frame_callback, &frame_listener, const_cast<FullscreenClient*>(this));
+        info.frame_pacer.requested(FramePacer::Clock::now());
+    }
+
+    wl_surface_commit(info.surface);
+}
 
-        // Wayland based toolkits typically use $XDG_RUNTIME_DIR to open shm pools
-        // so we try that before "/dev/shm". But confined snaps can't access "/dev/shm"
-        // so we try "/tmp" if both of the above fail.
-        for (auto dir : {const_cast<const char*>(getenv("XDG_RUNTIME_DIR")), "/dev/shm", "/tmp" })
+void egmde::FullscreenClient::frame_done(wl_callback* callback)
+{
+    std::lock_guard const lock{outputs_mutex};
+
+    for (auto& [_, info] : outputs)
+    {
+        if (info.frame_callback == callback)
         {
-            if (dir)
+            wl_callback_destroy(callback);
+            info.frame_callback = nullptr;
+            info.frame_pacer.done();
+
+            if (info.dirty)
             {
-                shm_dir = dir;
-                auto fd = open_shm_file();
-                if (fd >= 0)
-                    return fd;
+                eventfd_write(draw_signal, 1);
             }
+            return;
         }
-        return mir::Fd{};
+    }
+}
+
+auto egmde::FullscreenClient::shm_buffer_for(SurfaceInfo& info, int32_t width, int32_t height) const
+-> SurfaceInfo::ShmBuffer*
+{
+    static wl_buffer_listener const buffer_listener = {
+        [](void* self, wl_buffer* buffer) { static_cast<FullscreenClient*>(self)->buffer_released(buffer); },
     };
 
-    auto fd = open_shm_file();
+    if (info.shm_width != width || info.shm_height != height ||
+        (info.shm_width && shm_arena->is_stale(info.shm_buffers[0].allocation)))
+    {
+        auto const stride = 4*width;
+        auto const buffer_size = size_t(stride) * height;
+
+        // Buffers the compositor is still reading are retired rather than freed, so they won't be drawn over
+        info.reset_buffer();
 
-    if (fd < 0) {
-        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to open shm buffer"}));
+        for (auto& shm_buffer : info.shm_buffers)
+        {
+            shm_buffer.allocation = shm_arena->allocate(buffer_size);
+            shm_buffer.buffer = shm_arena->create_buffer(
+                shm_buffer.allocation,
+                width, height, stride,
+                WL_SHM_FORMAT_ARGB8888);
+            wl_buffer_add_listener(shm_buffer.buffer, &buffer_listener, const_cast<FullscreenClient*>(this));
+        }
+
+        info.shm_arena = shm_arena.get();
+        info.shm_width = width;
+        info.shm_height = height;
     }
 
-    if (auto error = posix_fallocate(fd, 0, size))
+    auto const free_buffer = std::find_if(
+        begin(info.shm_buffers), end(info.shm_buffers), [](auto const& shm_buffer) { return !shm_buffer.busy; });
+
+    if (free_buffer == end(info.shm_buffers))
     {
-        BOOST_THROW_EXCEPTION((std::system_error{error, std::system_category(), "Failed to allocate shm buffer"}));
+        info.draw_deferred = true;
+        return nullptr;
     }
 
-    if ((*data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    free_buffer->busy = true;
+    info.buffer = free_buffer->buffer;
+    info.draw_deferred = false;
+
+    return &*free_buffer;
+}
+
+auto egmde::FullscreenClient::shm_content(SurfaceInfo::ShmBuffer const& shm_buffer) const -> unsigned char*
+{
+    // Allocating may move the arena's mapping, so this is only valid until the next allocation
+    return shm_arena->data(shm_buffer.allocation);
+}
+
+void egmde::FullscreenClient::damage_buffer(SurfaceInfo const& info, std::optional<Rectangle> const& area) const
+{
+    if (compositor_version < WL_SURFACE_DAMAGE_BUFFER_SINCE_VERSION)
+    {
+        return;
+    }
+
+    if (area)
     {
-        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to mmap buffer"}));
+        wl_surface_damage_buffer(
+            info.surface,
+            area->left().as_int(),
+            area->top().as_int(),
+            area->size.width.as_int(),
+            area->size.height.as_int());
     }
+    else
+    {
+        wl_surface_damage_buffer(info.surface, 0, 0, INT32_MAX, INT32_MAX);
+    }
+}
 
-    return {
-        wl_shm_create_pool(shm, fd, size),
-        [](auto* shm)
+void egmde::FullscreenClient::buffer_released(wl_buffer* buffer)
+{
+    std::lock_guard const lock{outputs_mutex};
+
+    for (auto& [_, info] : outputs)
+    {
+        if (info.release_shm_buffer(buffer))
+        {
+            if (info.draw_deferred)
+            {
+                draw(info);
+            }
+            return;
+        }
+    }
+
+    if (shm_arena->release(buffer))
+    {
+        move_off_stale_shm_pools();
+    }
+}
+
+void egmde::FullscreenClient::move_off_stale_shm_pools()
+{
+    if (!shm_arena || !shm_arena->has_stale_pools())
+    {
+        return;
+    }
+
+    for (auto& [_, info] : outputs)
+    {
+        if (info.shm_width && shm_arena->is_stale(info.shm_buffers[0].allocation))
         {
-            wl_shm_pool_destroy(shm);
-        }};
+            // Otherwise the content already on screen wouldn't be drawn again
+            info.content_key.reset();
+            draw(info);
+        }
+    }
 }
 
 egmde::FullscreenClient::~FullscreenClient()
@@ -426,16 +696,17 @@ egmde::FullscreenClient::~FullscreenClient()
 
 void egmde::FullscreenClient::new_global(struct wl_registry* registry, uint32_t id, char const* interface, uint32_t version)
 {
-    (void)version;
-
     if (strcmp(interface, "wl_compositor") == 0)
     {
+        // Version 4 adds wl_surface_damage_buffer()
+        compositor_version = std::min(version, 4u);
         compositor =
-            static_cast<decltype(compositor)>(wl_registry_bind(registry, id, &wl_compositor_interface, 3));
+            static_cast<decltype(compositor)>(wl_registry_bind(registry, id, &wl_compositor_interface, compositor_version));
     }
     else if (strcmp(interface, "wl_shm") == 0)
     {
         shm = static_cast<decltype(shm)>(wl_registry_bind(registry, id, &wl_shm_interface, 1));
+        shm_arena = std::make_unique<ShmArena>(shm);
         // Normally we'd add a listener to pick up the supported formats here
         // As luck would have it, I know that argb8888 is the only format we support :)
     }
@@ -467,6 +738,16 @@ void egmde::FullscreenClient::new_global(struct wl_registry* registry, uint32_t
     {
         shell = static_cast<decltype(shell)>(wl_registry_bind(registry, id, &wl_shell_interface, 1));
     }
+    else if (strcmp(interface, "wp_viewporter") == 0)
+    {
+        viewporter = static_cast<decltype(viewporter)>(
+            wl_registry_bind(registry, id, &wp_viewporter_interface, 1));
+    }
+    else if (strcmp(interface, "wp_single_pixel_buffer_manager_v1") == 0)
+    {
+        single_pixel_buffer_manager = static_cast<decltype(single_pixel_buffer_manager)>(
+            wl_registry_bind(registry, id, &wp_single_pixel_buffer_manager_v1_interface, 1));
+    }
 }
 
 void egmde::FullscreenClient::remove_global(
@@ -482,11 +763,69 @@ void egmde::FullscreenClient::remove_global(
     // TODO: We should probably also delete any other globals we've bound to that disappear.
 }
 
-void egmde::FullscreenClient::run(wl_display* display)
+void egmde::FullscreenClient::read_diagnostic_events()
 {
-    char inotify_buffer[sizeof(inotify_event) + NAME_MAX + 1];
+    alignas(inotify_event) char buffer[16 * (sizeof(inotify_event) + NAME_MAX + 1)];
+    auto const filename = diagnostic_path.value_or("").filename().string();
+    bool const burst_started = !pending_diagnostic_exists;
 
-    while (!(fds[shutdown].revents & (POLLIN | POLLERR)))
+    ssize_t length;
+    while ((length = read(diagnostic_signal, buffer, sizeof(buffer))) > 0)
+    {
+        for (auto next = buffer; next < buffer + length;)
+        {
+            auto const event = reinterpret_cast<inotify_event const*>(next);
+            next += sizeof(inotify_event) + event->len;
+
+            if (!event->len || event->name != filename)
+                continue;
+
+            // Writers that replace the file by renaming another over it are seen as moves
+            if (event->mask & (IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO))
+            {
+                pending_diagnostic_exists = true;
+            }
+            else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+            {
+                pending_diagnostic_exists = false;
+            }
+        }
+    }
+
+    if (length < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to read diagnostic file events"}));
+    }
+
+    if (!pending_diagnostic_exists)
+        return;
+
+    if (diagnostic_debounce == 0)
+    {
+        diagnostic_changed();
+    }
+    else if (burst_started)
+    {
+        // Changes until the timer expires are drawn together: a writer creating, writing and closing the file in
+        // quick succession causes one redraw of the final content
+        diagnostic_debounce_timer.arm(std::chrono::milliseconds{diagnostic_debounce});
+    }
+}
+
+void egmde::FullscreenClient::diagnostic_changed()
+{
+    if (!pending_diagnostic_exists)
+        return;
+
+    diagnostic_exists = *pending_diagnostic_exists;
+    pending_diagnostic_exists.reset();
+    ++diagnostic_changes;
+    draw(RedrawTarget::diagnostic_outputs);
+}
+
+void egmde::FullscreenClient::run(wl_display* display)
+{
+    while (running)
     {
         while (wl_display_prepare_read(display) != 0)
         {
@@ -496,69 +835,46 @@ void egmde::FullscreenClient::run(wl_display* display)
             }
         }
 
-        if (poll(fds, indices, -1) == -1)
-        {
-            wl_display_cancel_read(display);
-            BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to wait for event"}));
-        }
+        display_read = false;
 
-        if (fds[display_fd].revents & POLLOUT)
+        try
         {
-            flush_display();
+            reactor.dispatch();
         }
-
-        if (fds[display_fd].revents & (POLLIN | POLLERR))
+        catch (...)
         {
-            if (wl_display_read_events(display))
+            if (!display_read)
             {
-                BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to read Wayland events"}));
+                wl_display_cancel_read(display);
             }
+            throw;
         }
-        else
+
+        if (!display_read)
         {
             wl_display_cancel_read(display);
         }
 
-        bool redraw = false;
-
-        if (fds[draw_fd].revents & (POLLIN | POLLERR))
+        if (std::exchange(redraw_requested, false))
         {
-            eventfd_t foo;
-            eventfd_read(draw_signal, &foo);
-            redraw = true;
+            draw_dirty_outputs();
         }
+    }
+}
 
-        if (fds[diagnostic].revents & (POLLIN | POLLERR))
-        {
-            read(fds[diagnostic].fd, inotify_buffer, sizeof(inotify_buffer));
-
-            auto ib = reinterpret_cast<inotify_event*>(inotify_buffer);
-
-            if (ib->mask & (IN_CLOSE_WRITE | IN_CREATE)
-                && ib->name == diagnostic_path.value_or("").filename().string())
-            {
-                diagnostic_exists = true;
-                redraw = true;
-            }
-            else if (ib->mask & IN_DELETE
-                && ib->name == diagnostic_path.value_or("").filename().string())
-            {
-                diagnostic_exists = false;
-                redraw = true;
-            }
-        }
+void egmde::FullscreenClient::display_ready(uint32_t events)
+{
+    if (events & EPOLLOUT)
+    {
+        flush_display();
+    }
 
-        if (redraw)
+    if (events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+    {
+        display_read = true;
+        if (wl_display_read_events(display))
         {
-            {
-                std::lock_guard const lock{outputs_mutex};
-
-                for (auto& output : outputs)
-                {
-                    draw_screen(output.second, should_draw_crash());
-                }
-            }
-            flush_display();
+            BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to read Wayland events"}));
         }
     }
 }
@@ -718,9 +1034,12 @@ void egmde::FullscreenClient::flush_display()
         // wl_display_flush may fail with errno == EAGAIN if the write buffer is full
         if (errno == EAGAIN)
         {
-            // In this case, we should also wake if the display_fd is writable, so we can
+            // In this case, we should also wake if the display fd is writable, so we can
             // finish flushing.
-            fds[display_fd].events |= POLLOUT;
+            if (!std::exchange(display_writable_wanted, true))
+            {
+                reactor.modify_fd(wl_display_get_fd(display), EPOLLIN | EPOLLOUT);
+            }
         }
         else
         {
@@ -730,7 +1049,10 @@ void egmde::FullscreenClient::flush_display()
     else
     {
         // We've fully flushed our pending events to the server; we don't need to wake-on-writable
-        fds[display_fd].events &= ~POLLOUT;
+        if (std::exchange(display_writable_wanted, false))
+        {
+            reactor.modify_fd(wl_display_get_fd(display), EPOLLIN);
+        }
     }
 }
 
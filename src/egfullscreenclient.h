@@ -19,6 +19,11 @@
 #ifndef EGMDE_EGFULLSCREENCLIENT_H
 #define EGMDE_EGFULLSCREENCLIENT_H
 
+#include "frame_pacer.h"
+#include "reactor.h"
+#include "shm_arena.h"
+#include "worker_pool.h"
+
 #include <mir/fd.h>
 #include <mir/geometry/rectangles.h>
 
@@ -26,6 +31,8 @@
 
 #include <sys/inotify.h>
 
+#include <array>
+#include <atomic>
 #include <filesystem>
 #include <functional>
 #include <map>
@@ -33,13 +40,11 @@
 #include <mutex>
 #include <optional>
 #include <unordered_map>
+#include <vector>
 
-#include <sys/poll.h>
-
-namespace miral {
-    class MirRunner;
-    class FdHandle;
-}
+struct wp_viewporter;
+struct wp_viewport;
+struct wp_single_pixel_buffer_manager_v1;
 
 class WindowManagerObserver;
 
@@ -54,7 +59,8 @@ public:
         wl_display* display,
         std::optional<Path> diagnostic_path,
         uint diagnostic_delay,
-        miral::MirRunner* runner,
+        uint diagnostic_debounce,
+        uint render_threads,
         WindowManagerObserver* window_manager_observer);
 
     virtual ~FullscreenClient();
@@ -63,12 +69,16 @@ public:
 
     void stop();
 
-    auto make_shm_pool(size_t size, void** data) const
-    -> std::unique_ptr<wl_shm_pool, std::function<void(wl_shm_pool*)>>;
+    /// How the shm memory buffers are drawn into is being used (all zero before the compositor's wl_shm is bound)
+    auto shm_stats() const -> ShmArena::Stats;
 
     wl_display* display = nullptr;
     wl_compositor* compositor = nullptr;
+    uint32_t compositor_version = 0;
     wl_shell* shell = nullptr;
+    // Optional: null if the compositor doesn't offer them
+    wp_viewporter* viewporter = nullptr;
+    wp_single_pixel_buffer_manager_v1* single_pixel_buffer_manager = nullptr;
 
     class Output
     {
@@ -130,21 +140,83 @@ public:
         explicit SurfaceInfo(Output const* output);
         ~SurfaceInfo();
 
+        SurfaceInfo(SurfaceInfo const&) = delete;
+        SurfaceInfo& operator=(SurfaceInfo const&) = delete;
+
         void clear_window();
         void reset_buffer();
 
+        /// Marks buffer as free to draw into again. Returns false if it isn't one of ours.
+        auto release_shm_buffer(wl_buffer* buffer) -> bool;
+
         // Screen description
         Output const* output;
 
         // Content
-        void* content_area = nullptr;
         wl_surface* surface = nullptr;
         wl_shell_surface* shell_surface = nullptr;
-        wl_buffer* buffer = nullptr;
-        size_t buffer_size = 0;
+        wp_viewport* viewport = nullptr;
+        wl_buffer* buffer = nullptr;                // The buffer most recently attached to surface
+        wl_buffer* single_pixel_buffer = nullptr;
+
+        // Redraw scheduling: a dirty surface is drawn once the compositor has shown its last commit
+        bool dirty = false;
+        wl_callback* frame_callback = nullptr;      // Pending from the last commit
+        FramePacer frame_pacer{frame_callback_timeout};
+
+        /// How long to wait for a frame callback before drawing anyway
+        static std::chrono::milliseconds constexpr frame_callback_timeout{100};
+
+        // Describes what has been drawn into buffer, so that unchanged content isn't redrawn
+        struct ContentKey
+        {
+            int32_t width;
+            int32_t height;
+            int32_t transform;
+            int32_t scale_factor;
+            bool diagnostic;
+            uint32_t colours[2];
+            uint64_t diagnostic_generation;
+
+            bool operator==(ContentKey const&) const = default;
+        };
+
+        // Buffers allocated from the client's shm arena, so that one can be drawn while the compositor reads another
+        struct ShmBuffer
+        {
+            wl_buffer* buffer = nullptr;
+            ShmArena::Allocation allocation;
+            bool busy = false;                      // From being attached until the compositor releases it
+
+            // What was last drawn into this buffer, and the area of it drawn over a plain background. When new
+            // content differs only in what is drawn over the background, only the two areas need repainting.
+            std::optional<ContentKey> content_key;
+            mir::geometry::Rectangle foreground;
+        };
+
+        std::array<ShmBuffer, 2> shm_buffers;
+
+        /// The shm buffer most recently attached, if buffer is one
+        auto attached_shm_buffer() const -> ShmBuffer const*;
+
+        ShmArena* shm_arena = nullptr;
+        int32_t shm_width = 0;                      // Zero unless shm_buffers have been allocated
+        int32_t shm_height = 0;
+        bool draw_deferred = false;                 // A draw found every shm buffer busy
+
+        std::optional<ContentKey> content_key;
+    };
+
+    /// Drawing an output is split so that outputs can be rendered in parallel. draw_screen() makes any Wayland
+    /// requests needed first (such as taking a buffer) on the client thread, then the render jobs fill in pixels on
+    /// render workers, each touching nothing another job does, and present attaches and commits on the client thread.
+    struct Frame
+    {
+        std::vector<std::function<void()>> render;
+        std::function<void()> present;
     };
 
-    virtual void draw_screen(SurfaceInfo& info, bool draws_crash) const = 0;
+    virtual auto draw_screen(SurfaceInfo& info, bool draws_crash) const -> Frame = 0;
 
 protected:
 
@@ -209,6 +281,29 @@ protected:
 
     void flush_display();
 
+    /// A buffer of width by height from info's shm pool that the compositor isn't reading, (re)allocating the pool
+    /// if the size has changed. The buffer becomes info.buffer and is marked busy, ready to be attached.
+    /// If every buffer is busy, returns null and draws again once the compositor releases one.
+    auto shm_buffer_for(SurfaceInfo& info, int32_t width, int32_t height) const -> SurfaceInfo::ShmBuffer*;
+
+    /// The pixels of shm_buffer, valid until the next call of shm_buffer_for()
+    auto shm_content(SurfaceInfo::ShmBuffer const& shm_buffer) const -> unsigned char*;
+
+    /// Commits info.surface, asking to be told when the compositor has shown it so that redraws are paced by it.
+    /// draw_screen() implementations commit through this rather than wl_surface_commit().
+    void commit_surface(SurfaceInfo& info) const;
+
+    /// Splits a buffer of size into horizontal bands that can be rendered concurrently: one per render thread, but
+    /// none so small that it isn't worth a job of its own
+    auto render_bands(mir::geometry::Size size) const -> std::vector<mir::geometry::Rectangle>;
+
+    /// Tells the compositor which area of the buffer about to be committed to info.surface has changed (all of it if
+    /// area is nullopt). Does nothing if the compositor is too old to accept buffer damage.
+    void damage_buffer(SurfaceInfo const& info, std::optional<mir::geometry::Rectangle> const& area) const;
+
+    /// Incremented whenever the diagnostic file is created, written or deleted
+    auto diagnostic_generation() const -> uint64_t;
+
 private:
     void on_new_output(Output const*);
 
@@ -216,11 +311,46 @@ private:
 
     void on_output_gone(Output const*);
 
-    void draw() const;
+    /// The outputs a redraw request affects
+    enum class RedrawTarget
+    {
+        diagnostic_outputs,     ///< Those showing the diagnostic, or all of them if it should now be shown
+        all_outputs
+    };
+
+    /// Wakes the client to redraw target
+    void draw(RedrawTarget target);
+
+    /// Marks info dirty and wakes the client to redraw it. Requires outputs_mutex to be held.
+    void draw(SurfaceInfo& info);
+
+    /// Draws the dirty outputs that aren't waiting on a frame callback, and sets frame_callback_timer to draw
+    /// the rest if theirs don't arrive in time
+    void draw_dirty_outputs();
+
+    /// Draws each of infos, rendering them in parallel. Requires outputs_mutex to be held.
+    void draw_screens(std::vector<SurfaceInfo*> const& infos, bool draws_crash);
+
+    void buffer_released(wl_buffer* buffer);
+
+    /// Redraws outputs whose buffers are in a stale shm pool, so that the pool can be unmapped.
+    /// Requires outputs_mutex to be held.
+    void move_off_stale_shm_pools();
+    void frame_done(wl_callback* callback);
 
     void check_for_exposed_outputs();
 
-    mir::Fd const draw_signal;
+    /// Handles the Wayland display becoming readable or writable, with a read prepared
+    void display_ready(uint32_t events);
+
+    Reactor reactor;
+    bool display_read = false;                  // Whether display_ready() read the prepared read
+    bool display_writable_wanted = false;       // Whether a flush is waiting for the display to become writable
+    bool redraw_requested = false;
+    bool running = true;
+
+    mir::Fd const draw_signal;                  // Not a semaphore: any number of requests are handled by one redraw
+    std::atomic<unsigned> pending_targets{0};  // Bits set by draw(RedrawTarget)
     mir::Fd const shutdown_signal;
     mir::Fd const diagnostic_signal;
 
@@ -231,6 +361,8 @@ private:
 
     wl_seat* seat = nullptr;
     wl_shm* shm = nullptr;
+    std::unique_ptr<ShmArena> shm_arena;
+    WorkerPool render_workers;
 
     void new_global(
         struct wl_registry* registry,
@@ -248,6 +380,12 @@ private:
     void set_diagnostic_delay_alarm();
     void notify_diagnostic_delay_expired();
 
+    /// Reads every queued inotify event, noting whether the diagnostic file now exists
+    void read_diagnostic_events();
+
+    /// Redraws for changes to the diagnostic file since the last time this was called
+    void diagnostic_changed();
+
     auto inline should_draw_crash() -> bool;
 
     std::unique_ptr<wl_registry, decltype(&wl_registry_destroy)> registry;
@@ -257,23 +395,17 @@ private:
     std::optional<Path> diagnostic_path;
     std::optional<int> diagnostic_wd;
     uint diagnostic_delay;
-    std::unique_ptr<miral::FdHandle> diagnostic_timer_handle;
+    uint diagnostic_debounce;                   // Milliseconds
+    Reactor::Timer diagnostic_delay_timer{reactor, [this] { notify_diagnostic_delay_expired(); }};
+    Reactor::Timer diagnostic_debounce_timer{reactor, [this] { diagnostic_changed(); }};  // Armed by the first of a burst of changes
+    Reactor::Timer frame_callback_timer{reactor, [this] { redraw_requested = true; }};
 
-    miral::MirRunner* const runner;
     WindowManagerObserver* const window_manager_observer;
 
     bool diagnostic_wants_to_draw = false;
     bool diagnostic_exists = false;
-
-    enum FdIndices {
-        display_fd = 0,
-        draw_fd,
-        diagnostic,
-        shutdown,
-        indices
-    };
-
-    pollfd fds[indices];
+    uint64_t diagnostic_changes = 0;
+    std::optional<bool> pending_diagnostic_exists;  // Set by changes not yet redrawn for
 };
 }
 
@@ -63,6 +63,10 @@ int main(int argc, char const* argv[])
                                "diagnostic-path",  "Path (including filename) of diagnostic file", ""},
             ConfigurationOption{[&] (int option) { background_client.set_diagnostic_delay(option);},
                                 "diagnostic-delay", "Delay time (in seconds) before displaying diagnostic screen", 0},
+            ConfigurationOption{[&] (int option) { background_client.set_diagnostic_debounce(option);},
+                                "diagnostic-debounce", "Time (in milliseconds) to gather changes to the diagnostic file before redrawing", 100},
+            ConfigurationOption{[&] (int option) { background_client.set_render_threads(option);},
+                                "background-render-threads", "Threads rendering the background (0 for one per core)", 0},
             StartupInternalClient{std::ref(background_client)},
             ConfigurationOption{[&](bool option) { init_authorise_without_apparmor(option);},
                                "authorise-without-apparmor", "Use /proc/<pid>/cmdline if AppArmor is unavailable", false },
@@ -0,0 +1,45 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame_pacer.h"
+
+egmde::FramePacer::FramePacer(Clock::duration timeout) :
+    timeout{timeout}
+{
+}
+
+void egmde::FramePacer::requested(Clock::time_point now)
+{
+    requested_at = now;
+}
+
+void egmde::FramePacer::done()
+{
+    requested_at.reset();
+}
+
+auto egmde::FramePacer::waiting(Clock::time_point now) const -> bool
+{
+    return wait_left(now).has_value();
+}
+
+auto egmde::FramePacer::wait_left(Clock::time_point now) const -> std::optional<Clock::duration>
+{
+    if (!requested_at || now - requested_at.value() >= timeout)
+        return std::nullopt;
+
+    return requested_at.value() + timeout - now;
+}
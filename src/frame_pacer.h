@@ -0,0 +1,52 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_FRAME_PACER_H
+#define FRAME_FRAME_PACER_H
+
+#include <chrono>
+#include <optional>
+
+namespace egmde
+{
+/// Paces a surface's redraws by its frame callbacks, but gives up on one that hasn't arrived within a timeout:
+/// a compositor may hold back frame callbacks for a surface it isn't showing
+class FramePacer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit FramePacer(Clock::duration timeout);
+
+    /// Notes that a frame callback was requested at now
+    void requested(Clock::time_point now);
+
+    /// Notes that the frame callback arrived, or was dropped
+    void done();
+
+    /// Whether a redraw should still wait for the frame callback requested
+    auto waiting(Clock::time_point now) const -> bool;
+
+    /// How long until waiting() gives up, or nullopt if it already has (or there's nothing to wait for)
+    auto wait_left(Clock::time_point now) const -> std::optional<Clock::duration>;
+
+private:
+    Clock::duration const timeout;
+    std::optional<Clock::time_point> requested_at;
+};
+}
+
+#endif //FRAME_FRAME_PACER_H
@@ -15,6 +15,7 @@
  */
 
 #include "frame_window_manager.h"
+#include "display_configuration_builder.h"
 #include "layout_metadata.h"
 #include "snap_name_of.h"
 
@@ -245,6 +246,9 @@ auto FrameWindowManagerPolicy::place_new_window(ApplicationInfo const& app_info,
 {
     WindowSpecification specification = MinimalWindowManager::place_new_window(app_info, request);
     WindowInfo window_info{};
+
+    // A new window is placed by the current layout, even if no output changed when it was selected
+    ++layout_generation;
     handle_layout(specification, app_info.application(), window_info);
 
     // TODO This is a hack to ensure the wallpaper remains in the background
@@ -279,13 +283,22 @@ bool FrameWindowManagerPolicy::assign_to_output(
     mir::optional_value<std::string> const& title,
     std::string_view snap_name)
 {
-    return placement_mapping.set_output_for_surface(specification, title)
-        || placement_mapping.set_output_for_snap(specification, snap_name);
+    auto output_id = title ? placement_mapping.output_for_surface(title.value()) : std::nullopt;
+    if (!output_id)
+        output_id = placement_mapping.output_for_snap(snap_name);
+
+    if (!output_id)
+        return false;
+
+    specification.output_id() = output_id.value();
+    return true;
 }
 
 void FrameWindowManagerPolicy::advise_delete_window(WindowInfo const& window_info)
 {
     MinimalWindowManager::advise_delete_window(window_info);
+    unbind_window(window_info.window());
+
     if (is_application(window_info))
     {
         window_count->increment_closed();
@@ -306,6 +319,10 @@ void FrameWindowManagerPolicy::handle_modify_window(WindowInfo& window_info, Win
     }
 
     MinimalWindowManager::handle_modify_window(window_info, specification);
+
+    // Moves and resizes only change the outputs a window overlaps, which are rebound as they are advised
+    if (specification.name().is_set())
+        bind_window(window_info);
 }
 
 void FrameWindowManagerPolicy::apply_bespoke_fullscreen_placement(
@@ -336,6 +353,21 @@ auto FrameWindowManagerPolicy::confirm_placement_on_display(
     return new_placement;
 }
 
+void FrameWindowManagerPolicy::advise_new_app(ApplicationInfo& app_info)
+{
+    MinimalWindowManager::advise_new_app(app_info);
+
+    // Identify the client while it connects, rather than in the middle of placing its windows
+    remember_snap_identity(app_info.application());
+}
+
+void FrameWindowManagerPolicy::advise_delete_app(ApplicationInfo const& app_info)
+{
+    forget_snap_identity(app_info.application());
+
+    MinimalWindowManager::advise_delete_app(app_info);
+}
+
 void FrameWindowManagerPolicy::advise_begin()
 {
     WindowManagementPolicy::advise_begin();
@@ -345,67 +377,94 @@ void FrameWindowManagerPolicy::advise_end()
 {
     WindowManagementPolicy::advise_end();
 
+    // Without knowing what the old layout placed exactly, every window needs relaying out
+    auto const layout_metadata_changed = current_layout_metadata() != bound_layout_metadata.get();
+    auto const all_windows = [this]
+        {
+            std::set<Window> windows;
+            tools.for_each_application([&windows](auto& app)
+                {
+                    for (auto& window : app.windows())
+                    {
+                        if (window)
+                            windows.insert(window);
+                    }
+                });
+            return windows;
+        };
+
     if (display_layout_has_changed)
     {
-        tools.for_each_application([this](auto& app)
-            {
-               for (auto& window : app.windows())
-               {
-                   if (window)
-                   {
-                       auto& info = tools.info_for(window);
-                       WindowSpecification specification;
-                       handle_layout(specification, app.application(), info);
-                       tools.modify_window(info, specification);
-                   }
-               }
-            });
+        auto const windows = layout_metadata_changed ?
+            all_windows() : windows_affected_by(changed_output_ids, changed_output_claims);
+
+        size_t modified = 0;
+        for (auto const& window : windows)
+        {
+            auto& info = tools.info_for(window);
+            WindowSpecification specification;
+            handle_layout(specification, window.application(), info);
+            if (modify_window_if_changed(info, specification))
+                ++modified;
+            bind_window(info);
+        }
+
+        mir::log_debug("Display layout changed: relaid out %zu of %zu windows, %zu modified and %zu already in place",
+                      windows.size(), window_bindings.size(), modified, windows.size() - modified);
+        bound_layout_metadata = cached_layout_metadata;
         display_layout_has_changed = false;
     }
 
     if (application_zones_have_changed)
     {
-        tools.for_each_application([this](auto& app)
+        auto const windows = layout_metadata_changed ? all_windows() : windows_affected_by(changed_zone_output_ids, {});
+
+        size_t modified = 0;
+        for (auto const& window : windows)
+        {
+            auto& info = tools.info_for(window);
+            WindowSpecification specification;
+            auto const is_positioned_exactly = try_position_exactly(specification, info, window.application());
+
+            if (!is_positioned_exactly && info.state() == mir_window_state_fullscreen)
             {
-               for (auto& window : app.windows())
-               {
-                   if (window)
-                   {
-                       auto& info = tools.info_for(window);
-                       WindowSpecification specification;
-                       auto const is_positioned_exactly = try_position_exactly(specification, info, app.application());
-
-                       if (!is_positioned_exactly && info.state() == mir_window_state_fullscreen)
-                       {
-                           WindowSpecification specification;
-                           specification.state() = mir_window_state_maximized;
-                           tools.place_and_size_for_state(specification, info);
-                           specification.state() = mir_window_state_fullscreen;
-                           tools.modify_window(info, specification);
-                       }
-                   }
-               }
-            });
+                WindowSpecification specification;
+                specification.state() = mir_window_state_maximized;
+                tools.place_and_size_for_state(specification, info);
+                specification.state() = mir_window_state_fullscreen;
+                if (modify_window_if_changed(info, specification))
+                    ++modified;
+            }
+        }
 
+        mir::log_debug("Application zones changed: %zu of %zu windows modified", modified, windows.size());
         application_zones_have_changed = false;
     }
+
+    changed_output_ids.clear();
+    changed_output_claims.clear();
+    changed_zone_output_ids.clear();
 }
 
 void FrameWindowManagerPolicy::advise_application_zone_create(Zone const& application_zone)
 {
     WindowManagementPolicy::advise_application_zone_create(application_zone);
+    note_zone_changed(application_zone);
     application_zones_have_changed = true;
 }
 
 void FrameWindowManagerPolicy::advise_application_zone_update(Zone const& updated, Zone const& original)
 {
     WindowManagementPolicy::advise_application_zone_update(updated, original);
+    note_zone_changed(updated);
+    note_zone_changed(original);
     application_zones_have_changed = true;
 }
 
 void FrameWindowManagerPolicy::advise_application_zone_delete(Zone const& application_zone)
 {
     WindowManagementPolicy::advise_application_zone_delete(application_zone);
+    note_zone_changed(application_zone);
     application_zones_have_changed = true;
 }
 
@@ -413,26 +472,32 @@ void FrameWindowManagerPolicy::advise_output_create(miral::Output const &output)
 {
     WindowManagementPolicy::advise_output_create(output);
 
-    placement_mapping.update(output);
+    placement_mapping.update(output.id(), output.attribute(surface_title), output.attribute(snap_name));
     active_outputs.push_back(output);
+    note_output_changed(output);
     display_layout_has_changed = true;
+    ++layout_generation;
 }
 
 void FrameWindowManagerPolicy::advise_output_delete(miral::Output const& output)
 {
     WindowManagementPolicy::advise_output_delete(output);
 
-    placement_mapping.clear(output);
+    placement_mapping.clear(output.id());
+    note_output_changed(output);
     active_outputs.erase(std::remove_if(active_outputs.begin(), active_outputs.end(), [&output](miral::Output const& other)
     {
         return other.id() == output.id();
     }), active_outputs.end());
     display_layout_has_changed = true;
+    ++layout_generation;
 }
 
 void FrameWindowManagerPolicy::advise_new_window(WindowInfo const& window_info)
 {
     MinimalWindowManager::advise_new_window(window_info);
+    bind_window(window_info);
+
     if (is_application(window_info))
     {
         window_manager_observer.process_window_opened_callbacks();
@@ -440,103 +505,231 @@ void FrameWindowManagerPolicy::advise_new_window(WindowInfo const& window_info)
     }
 }
 
-void FrameWindowManagerPolicy::advise_output_update(Output const& updated, Output const& /*original*/)
+void FrameWindowManagerPolicy::advise_move_to(WindowInfo const& window_info, Point top_left)
 {
-    placement_mapping.update(updated);
+    MinimalWindowManager::advise_move_to(window_info, top_left);
+
+    // window_info still has the old position
+    auto const& window = window_info.window();
+    rebind_window_extents(window, {top_left, window.size()});
+}
+
+void FrameWindowManagerPolicy::advise_resize(WindowInfo const& window_info, Size const& new_size)
+{
+    MinimalWindowManager::advise_resize(window_info, new_size);
+
+    // window_info still has the old size
+    auto const& window = window_info.window();
+    rebind_window_extents(window, {window.top_left(), new_size});
+}
+
+void FrameWindowManagerPolicy::advise_output_update(Output const& updated, Output const& original)
+{
+    placement_mapping.update(updated.id(), updated.attribute(surface_title), updated.attribute(snap_name));
+    std::replace_if(active_outputs.begin(), active_outputs.end(), [&updated](miral::Output const& other)
+    {
+        return other.id() == updated.id();
+    }, updated);
+
+    // Both where the output was and where it is now, and whatever it claimed before as well as now
+    note_output_changed(original);
+    note_output_changed(updated);
     display_layout_has_changed = true;
+    ++layout_generation;
 }
 
-void FrameWindowManagerPolicy::PlacementMapping::update(Output const& output)
+bool FrameWindowManagerPolicy::try_position_exactly(
+    WindowSpecification& spec,
+    WindowInfo const& window_info,
+    Application const& application) const
 {
-    auto const output_id = output.id();
+    auto const layout_metadata = current_layout_metadata();
+    if (!layout_metadata)
+        return false;
 
-    surface_title_to_output_id.erase(
-        std::remove_if(
-            begin(surface_title_to_output_id),
-            end(surface_title_to_output_id),
-            [output_id](auto const& e) { return e.second == output_id; }),
-        end(surface_title_to_output_id));
+    auto const snap_instance_name = application ? snap_instance_name_of(application) : "";
+    auto const surface_title = spec.name() ? spec.name() : window_info.name();
 
-    if (auto const attr = output.attribute(surface_title))
-        surface_title_to_output_id.emplace_back(attr.value(), output_id);
+    return layout_metadata->try_layout(spec, surface_title, snap_instance_name);
+}
 
-    snap_name_to_output_id.erase(
-        std::remove_if(
-            begin(snap_name_to_output_id),
-            end(snap_name_to_output_id),
-            [output_id](auto const& e) { return e.second == output_id; }),
-        end(snap_name_to_output_id));
+auto FrameWindowManagerPolicy::current_layout_metadata() const -> LayoutMetadata const*
+{
+    std::pair const generation{layout_generation, display_configuration_loads()};
+    if (cached_layout_generation != generation)
+    {
+        /// Retrieve the layout information from the "applications" key in the layout's userdata.
+        cached_layout_metadata.reset();
+        auto const layout_userdata = display_config.layout_userdata("applications");
+        if (layout_userdata.has_value())
+            cached_layout_metadata = std::any_cast<std::shared_ptr<LayoutMetadata>>(layout_userdata.value());
+
+        cached_layout_generation = generation;
+    }
 
-    if (auto const attr = output.attribute(snap_name))
-        snap_name_to_output_id.emplace_back(attr.value(), output_id);
+    return cached_layout_metadata.get();
 }
 
-void FrameWindowManagerPolicy::PlacementMapping::clear(Output const& output)
+void FrameWindowManagerPolicy::bind_window(WindowInfo const& window_info)
 {
-    auto const output_id = output.id();
+    auto const window = window_info.window();
+    unbind_window(window);
 
-    surface_title_to_output_id.erase(
-        std::remove_if(
-            begin(surface_title_to_output_id),
-            end(surface_title_to_output_id),
-            [output_id](auto const& e) { return e.second == output_id; }),
-        end(surface_title_to_output_id));
+    auto const application = window.application();
+    WindowBinding binding{
+        window_info.name(),
+        application ? snap_instance_name_of(application) : "",
+        false,
+        false,
+        {}};
 
-    snap_name_to_output_id.erase(
-        std::remove_if(
-            begin(snap_name_to_output_id),
-            end(snap_name_to_output_id),
-            [output_id](auto const& e) { return e.second == output_id; }),
-        end(snap_name_to_output_id));
+    WindowSpecification specification;
+    if (try_position_exactly(specification, window_info, application))
+    {
+        binding.positioned_exactly = true;
+    }
+    else if (assign_to_output(specification, binding.title, binding.snap_instance_name))
+    {
+        binding.claimed = true;
+        binding.output_ids.push_back(specification.output_id().value());
+    }
+    else
+    {
+        binding.output_ids = output_ids_overlapping({window.top_left(), window.size()});
+    }
+
+    index_window(window, binding);
+    window_bindings.emplace(window, std::move(binding));
 }
 
-bool FrameWindowManagerPolicy::PlacementMapping::set_output_for_surface(
-    WindowSpecification& specification,
-    mir::optional_value<std::string> const& title) const
+void FrameWindowManagerPolicy::unbind_window(Window const& window)
 {
-    for (auto const& t2o : surface_title_to_output_id)
+    auto const binding = window_bindings.find(window);
+    if (binding == window_bindings.end())
+        return;
+
+    unindex_window(window, binding->second);
+    window_bindings.erase(binding);
+}
+
+void FrameWindowManagerPolicy::rebind_window_extents(Window const& window, Rectangle const& extents)
+{
+    // Where the layout puts a window depends on its extents only if it is neither placed exactly nor claimed
+    auto const bound = window_bindings.find(window);
+    if (bound == window_bindings.end() || bound->second.positioned_exactly || bound->second.claimed)
+        return;
+
+    auto& binding = bound->second;
+    auto output_ids = output_ids_overlapping(extents);
+    if (output_ids == binding.output_ids)
+        return;
+
+    unindex_window(window, binding);
+    binding.output_ids = std::move(output_ids);
+    index_window(window, binding);
+}
+
+void FrameWindowManagerPolicy::index_window(Window const& window, WindowBinding const& binding)
+{
+    for (auto const output_id : binding.output_ids)
+        output_id_to_windows[output_id].insert(window);
+
+    if (binding.output_ids.empty() && !binding.positioned_exactly)
+        windows_on_no_output.insert(window);
+}
+
+void FrameWindowManagerPolicy::unindex_window(Window const& window, WindowBinding const& binding)
+{
+    for (auto const output_id : binding.output_ids)
     {
-        if (t2o.first == title)
-        {
-            specification.output_id() = t2o.second;
-            return true;
-        }
+        auto const windows = output_id_to_windows.find(output_id);
+        windows->second.erase(window);
+        if (windows->second.empty())
+            output_id_to_windows.erase(windows);
     }
 
-    return false;
+    windows_on_no_output.erase(window);
 }
 
-bool FrameWindowManagerPolicy::PlacementMapping::set_output_for_snap(
-    WindowSpecification& specification,
-    std::string_view name) const
+auto FrameWindowManagerPolicy::output_ids_overlapping(Rectangle const& extents) const -> std::vector<int>
 {
-    for (auto const& s2o : snap_name_to_output_id)
+    // A window straddling outputs is affected by changes to any of them
+    std::vector<int> output_ids;
+    for (auto const& output : active_outputs)
     {
-        if (s2o.first == name)
+        if (output.extents().overlaps(extents))
+            output_ids.push_back(output.id());
+    }
+    return output_ids;
+}
+
+auto FrameWindowManagerPolicy::windows_affected_by(std::set<int> const& output_ids, std::set<std::string> const& names) const
+    -> std::set<Window>
+{
+    // A window on no output might be brought onto any of them
+    std::set<Window> windows{windows_on_no_output};
+
+    for (auto const output_id : output_ids)
+    {
+        if (auto const bound = output_id_to_windows.find(output_id); bound != output_id_to_windows.end())
+            windows.insert(bound->second.begin(), bound->second.end());
+    }
+
+    // Windows an output has (newly) claimed by title or snap name, wherever they are now
+    if (!names.empty())
+    {
+        for (auto const& [window, binding] : window_bindings)
         {
-            specification.output_id() = s2o.second;
-            return true;
+            if (names.contains(binding.title) || names.contains(binding.snap_instance_name))
+                windows.insert(window);
         }
     }
 
-    return false;
+    return windows;
 }
 
-bool FrameWindowManagerPolicy::try_position_exactly(
-    WindowSpecification& spec,
-    WindowInfo const& window_info,
-    Application const& application) const
+void FrameWindowManagerPolicy::note_output_changed(Output const& output)
 {
-    /// Retrieve the layout information from the "applications" key in the layout's userdata.
-    auto const snap_instance_name = application ? snap_instance_name_of(application) : "";
-    auto const surface_title = spec.name() ? spec.name() : window_info.name();
+    changed_output_ids.insert(output.id());
 
-    std::shared_ptr<LayoutMetadata> layout_metadata;
-    auto const layout_userdata = display_config.layout_userdata("applications");
-    if (layout_userdata.has_value())
-        layout_metadata = std::any_cast<std::shared_ptr<LayoutMetadata>>(layout_userdata.value());
+    // Windows on the outputs it overlaps may now (or no longer) overlap it
+    note_outputs_overlapping(output.extents(), changed_output_ids);
 
-    if (layout_metadata && layout_metadata->try_layout(spec, surface_title, snap_instance_name))
-        return true;
-    return false;
+    for (auto const& attribute : {surface_title, snap_name})
+    {
+        if (auto const claim = output.attribute(attribute); claim && !claim.value().empty())
+            changed_output_claims.insert(claim.value());
+    }
+}
+
+void FrameWindowManagerPolicy::note_zone_changed(Zone const& zone)
+{
+    note_outputs_overlapping(zone.extents(), changed_zone_output_ids);
+}
+
+void FrameWindowManagerPolicy::note_outputs_overlapping(Rectangle const& extents, std::set<int>& output_ids) const
+{
+    for (auto const output_id : output_ids_overlapping(extents))
+        output_ids.insert(output_id);
+}
+
+bool FrameWindowManagerPolicy::modify_window_if_changed(WindowInfo& window_info, WindowSpecification const& specification)
+{
+    // Modifying a window, even to what it already is, sends its client a configure event
+    auto const& window = window_info.window();
+    auto const changes_state = specification.state().is_set() && specification.state().value() != window_info.state();
+    auto const moves = specification.top_left().is_set() && specification.top_left().value() != window.top_left();
+    auto const resizes = specification.size().is_set() && specification.size().value() != window.size();
+    auto const changes_output = specification.output_id().is_set() && [&]
+        {
+            auto const binding = window_bindings.find(window);
+            return binding == window_bindings.end() ||
+                binding->second.output_ids != std::vector<int>{specification.output_id().value()};
+        }();
+
+    if (!changes_state && !moves && !resizes && !changes_output)
+        return false;
+
+    tools.modify_window(window_info, specification);
+    return true;
 }
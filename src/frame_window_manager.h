@@ -17,11 +17,20 @@
 #ifndef FRAME_WINDOW_MANAGER_H
 #define FRAME_WINDOW_MANAGER_H
 
+#include "placement_mapping.h"
+
 #include <miral/minimal_window_manager.h>
 #include <miral/output.h>
 #include <miral/display_configuration.h>
+#include <miral/window.h>
+#include <miral/zone.h>
 
+#include <map>
 #include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <utility>
 #include <vector>
 
 using namespace mir::geometry;
@@ -97,6 +106,11 @@ public:
     void advise_delete_window(miral::WindowInfo const& /*window_info*/) override;
 
     void advise_new_window(miral::WindowInfo const& window_info) override;
+    void advise_move_to(miral::WindowInfo const& window_info, Point top_left) override;
+    void advise_resize(miral::WindowInfo const& window_info, Size const& new_size) override;
+
+    void advise_new_app(miral::ApplicationInfo& app_info) override;
+    void advise_delete_app(miral::ApplicationInfo const& app_info) override;
 
     void advise_begin() override;
     void advise_end() override;
@@ -116,21 +130,65 @@ private:
     bool application_zones_have_changed = false;
     bool display_layout_has_changed = false;
 
-    class PlacementMapping
-    {
-    public:
-        void update(miral::Output const& output);
-        void clear(miral::Output const& output);
+    egmde::PlacementMapping placement_mapping;
+
+    std::vector<miral::Output> active_outputs;
 
-        bool set_output_for_surface(miral::WindowSpecification& specification, mir::optional_value<std::string> const& title) const;
-        bool set_output_for_snap(miral::WindowSpecification& specification, std::string_view name) const;
+    /// Bumped whenever outputs change. Mir tells the policy nothing when another layout with the same cards is
+    /// selected, so each new window's placement also bumps it. Reloads of the display configuration are counted
+    /// by display_configuration_loads().
+    unsigned layout_generation = 0;
 
-    private:
-        std::vector<std::pair<std::string, int>> surface_title_to_output_id;
-        std::vector<std::pair<std::string, int>> snap_name_to_output_id;
-    } placement_mapping;
+    /// The layout's "applications" userdata, as of cached_layout_generation and display_configuration_loads()
+    mutable std::shared_ptr<LayoutMetadata> cached_layout_metadata;
+    mutable std::optional<std::pair<unsigned, unsigned>> cached_layout_generation;
 
-    std::vector<miral::Output> active_outputs;
+    /// The current layout's application placements, or nullptr if it has none
+    auto current_layout_metadata() const -> LayoutMetadata const*;
+
+    /// What a window was last laid out against, so that a display change need only relayout the windows it affects
+    struct WindowBinding
+    {
+        std::string title;
+        std::string snap_instance_name;
+        bool positioned_exactly;
+        bool claimed;                   ///< Assigned to an output by its title or snap name
+        std::vector<int> output_ids;    ///< The outputs claiming or overlapping the window, unless positioned exactly
+    };
+
+    std::map<miral::Window, WindowBinding> window_bindings;
+    std::map<int, std::set<miral::Window>> output_id_to_windows;
+    std::set<miral::Window> windows_on_no_output;
+
+    /// The layout metadata window_bindings were made with
+    std::shared_ptr<LayoutMetadata> bound_layout_metadata;
+
+    /// Changes since advise_begin() that need the affected windows relaid out
+    std::set<int> changed_output_ids;
+    std::set<std::string> changed_output_claims;
+    std::set<int> changed_zone_output_ids;
+
+    /// Works out how the window is laid out from scratch, so only for new or renamed windows and relayouts
+    void bind_window(miral::WindowInfo const& window_info);
+    void unbind_window(miral::Window const& window);
+    /// Updates the outputs overlapped by a window that is about to occupy extents
+    void rebind_window_extents(miral::Window const& window, Rectangle const& extents);
+    void index_window(miral::Window const& window, WindowBinding const& binding);
+    void unindex_window(miral::Window const& window, WindowBinding const& binding);
+
+    auto output_ids_overlapping(Rectangle const& extents) const -> std::vector<int>;
+
+    /// The bound windows that changes to output_ids (or to the outputs claiming names) may move
+    auto windows_affected_by(std::set<int> const& output_ids, std::set<std::string> const& names) const
+        -> std::set<miral::Window>;
+
+    /// Applies specification unless the window already has the state, position, size and output it sets.
+    /// \returns true if the window was modified
+    bool modify_window_if_changed(miral::WindowInfo& window_info, miral::WindowSpecification const& specification);
+
+    void note_output_changed(miral::Output const& output);
+    void note_zone_changed(miral::Zone const& zone);
+    void note_outputs_overlapping(Rectangle const& extents, std::set<int>& output_ids) const;
 
     void handle_layout(
         miral::WindowSpecification& spec,
@@ -18,6 +18,8 @@
 #include "layout_metadata.h"
 #include <mir/log.h>
 
+#include <algorithm>
+
 namespace
 {
 bool try_parse_vec2(miral::DisplayConfiguration::Node const& node, const char* field_name, int& x, int& y)
@@ -61,30 +63,59 @@ bool try_parse_vec2(miral::DisplayConfiguration::Node const& node, const char* f
 }
 
 LayoutMetadata::LayoutMetadata(miral::DisplayConfiguration::Node const& applications_node)
+    : LayoutMetadata{applications_from(applications_node)}
 {
+}
+
+LayoutMetadata::LayoutMetadata(std::vector<LayoutApplicationPlacementStrategy> applications)
+    : applications{std::move(applications)}
+{
+    for (size_t i = 0; i != this->applications.size(); ++i)
+    {
+        if (auto const& snap_name = this->applications[i].snap_name)
+            snap_name_to_application.try_emplace(snap_name.value(), i);
+
+        if (auto const& surface_title = this->applications[i].surface_title)
+            surface_title_to_application.try_emplace(surface_title.value(), i);
+    }
+}
+
+auto LayoutMetadata::applications_from(miral::DisplayConfiguration::Node const& applications_node)
+    -> std::vector<LayoutApplicationPlacementStrategy>
+{
+    std::vector<LayoutApplicationPlacementStrategy> applications;
     applications_node.for_each([&](miral::DisplayConfiguration::Node const& node)
     {
         if (auto const app = LayoutApplicationPlacementStrategy::from_node(node))
             applications.push_back(app.value());
     });
+    return applications;
 }
 
 bool LayoutMetadata::try_layout(miral::WindowSpecification& specification,
     mir::optional_value<std::string> const& title,
     std::string_view snap_name) const
 {
-    for (auto const& app : applications)
+    // Whichever of the snap name and title matches the earlier application wins
+    auto match = applications.size();
+
+    if (auto const app = snap_name_to_application.find(snap_name); app != snap_name_to_application.end())
+        match = app->second;
+
+    if (title.is_set())
     {
-        if (app.snap_name == snap_name || (title.is_set() && app.surface_title == title))
-        {
-            specification.state() = mir_window_state_fullscreen;
-            specification.top_left() = app.position;
-            specification.size() = app.size;
-            return true;
-        }
+        if (auto const app = surface_title_to_application.find(title.value()); app != surface_title_to_application.end())
+            match = std::min(match, app->second);
     }
 
-    return false;
+    if (match == applications.size())
+        return false;
+
+    auto const& app = applications[match];
+    specification.state() = mir_window_state_fullscreen;
+    specification.top_left() = app.position;
+    specification.size() = app.size;
+    return true;
 }
 
 LayoutMetadata::LayoutApplicationPlacementStrategy::LayoutApplicationPlacementStrategy(
@@ -19,8 +19,11 @@
 
 #include <miral/version.h>
 
+#include "string_hash.h"
+
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <mir/geometry/point.h>
 #include <mir/geometry/size.h>
@@ -30,15 +33,6 @@
 class LayoutMetadata
 {
 public:
-    explicit LayoutMetadata(miral::DisplayConfiguration::Node const& layout_node);
-
-    /// Try to assign the window to a positition and size based on its title and snap name.
-    /// \returns true if successfully assigned, otherwise false
-    bool try_layout(miral::WindowSpecification& specification,
-        mir::optional_value<std::string> const& title,
-        std::string_view snap_name) const;
-
-private:
     class LayoutApplicationPlacementStrategy
     {
     public:
@@ -55,8 +49,26 @@ private:
         mir::geometry::Size const size;
     };
 
-    std::vector<LayoutApplicationPlacementStrategy> applications;
+    explicit LayoutMetadata(miral::DisplayConfiguration::Node const& layout_node);
+    explicit LayoutMetadata(std::vector<LayoutApplicationPlacementStrategy> applications);
+
+    /// Try to assign the window to a positition and size based on its title and snap name.
+    /// \returns true if successfully assigned, otherwise false
+    bool try_layout(miral::WindowSpecification& specification,
+        mir::optional_value<std::string> const& title,
+        std::string_view snap_name) const;
+
+private:
+    static auto applications_from(miral::DisplayConfiguration::Node const& applications_node)
+        -> std::vector<LayoutApplicationPlacementStrategy>;
+
+    std::vector<LayoutApplicationPlacementStrategy> const applications;
+
+    using ApplicationIndex = egmde::StringMap<size_t>;
 
+    /// The first of applications to match each snap name and surface title
+    ApplicationIndex snap_name_to_application;
+    ApplicationIndex surface_title_to_application;
 };
 
 
@@ -0,0 +1,365 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pixel_kernels.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+struct FillImplementation
+{
+    void (*fill)(uint32_t* dest, size_t count, uint32_t pixel);
+    char const* name;
+};
+
+[[maybe_unused]] void fill_scalar(uint32_t* dest, size_t count, uint32_t pixel)
+{
+    std::fill_n(dest, count, pixel);
+}
+
+#if defined(__SSE2__)
+void fill_sse2(uint32_t* dest, size_t count, uint32_t pixel)
+{
+    auto const value = _mm_set1_epi32(pixel);
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), value);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 4), value);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 8), value);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 12), value);
+    }
+    for (; i + 4 <= count; i += 4)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), value);
+    }
+
+    std::fill_n(dest + i, count - i, pixel);
+}
+#endif
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+void fill_avx2(uint32_t* dest, size_t count, uint32_t pixel)
+{
+    auto const value = _mm256_set1_epi32(pixel);
+
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), value);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i + 8), value);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i + 16), value);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i + 24), value);
+    }
+    for (; i + 8 <= count; i += 8)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), value);
+    }
+
+    std::fill_n(dest + i, count - i, pixel);
+}
+#endif
+
+#if defined(__ARM_NEON) && !defined(__SSE2__)
+void fill_neon(uint32_t* dest, size_t count, uint32_t pixel)
+{
+    auto const value = vdupq_n_u32(pixel);
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        vst1q_u32(dest + i, value);
+        vst1q_u32(dest + i + 4, value);
+        vst1q_u32(dest + i + 8, value);
+        vst1q_u32(dest + i + 12, value);
+    }
+    for (; i + 4 <= count; i += 4)
+    {
+        vst1q_u32(dest + i, value);
+    }
+
+    std::fill_n(dest + i, count - i, pixel);
+}
+#endif
+
+auto select_fill_implementation() -> FillImplementation
+{
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return {&fill_avx2, "avx2"};
+    }
+#endif
+
+#if defined(__SSE2__)
+    return {&fill_sse2, "sse2"};
+#elif defined(__ARM_NEON)
+    return {&fill_neon, "neon"};
+#else
+    return {&fill_scalar, "scalar"};
+#endif
+}
+
+auto fill_implementation() -> FillImplementation const&
+{
+    static FillImplementation const implementation = select_fill_implementation();
+    return implementation;
+}
+
+struct BlendImplementation
+{
+    void (*blend)(uint32_t* dest, unsigned char const* coverage, size_t count, uint32_t colour);
+    char const* name;
+};
+
+// x / 255 rounded down, for x <= 255 * 255, without a division so that it vectorizes
+inline unsigned div255(unsigned x)
+{
+    return (x + 1 + (x >> 8)) >> 8;
+}
+
+void blend_scalar(uint32_t* dest, unsigned char const* coverage, size_t count, uint32_t colour)
+{
+    unsigned char colour_bytes[4];
+    memcpy(colour_bytes, &colour, sizeof(colour_bytes));
+
+    for (size_t i = 0; i != count; ++i)
+    {
+        unsigned const alpha = div255(coverage[i] * colour_bytes[3]);
+        auto* const pixel = reinterpret_cast<unsigned char*>(dest + i);
+
+        for (int c = 0; c != 3; ++c)
+        {
+            pixel[c] = div255(pixel[c] * (255 - alpha)) + div255(colour_bytes[c] * alpha);
+        }
+    }
+}
+
+// In all the vector implementations below, a group of pixels with no coverage at all is skipped: blending
+// with zero alpha leaves a pixel unchanged.
+
+#if defined(__SSE2__)
+inline __m128i div255_epi16(__m128i x)
+{
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8)), 8);
+}
+
+void blend_sse2(uint32_t* dest, unsigned char const* coverage, size_t count, uint32_t colour)
+{
+    auto const zero = _mm_setzero_si128();
+    auto const max = _mm_set1_epi16(255);
+    auto const colour_alpha = _mm_set1_epi16(static_cast<short>(colour >> 24));
+    auto const colour_channels = _mm_unpacklo_epi8(_mm_set1_epi32(colour), zero);
+    auto const alpha_mask = _mm_set1_epi32(0xff000000);
+
+    // Blends two pixels, widened to 16 bits per channel, with their alphas repeated in each channel
+    auto const blend = [&](__m128i pixels, __m128i alpha)
+        {
+            return _mm_add_epi16(
+                div255_epi16(_mm_mullo_epi16(pixels, _mm_sub_epi16(max, alpha))),
+                div255_epi16(_mm_mullo_epi16(colour_channels, alpha)));
+        };
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        int32_t coverage4;
+        memcpy(&coverage4, coverage + i, sizeof(coverage4));
+        if (!coverage4)
+        {
+            continue;
+        }
+
+        auto const alpha = div255_epi16(_mm_mullo_epi16(
+            _mm_unpacklo_epi8(_mm_cvtsi32_si128(coverage4), zero),
+            colour_alpha));
+        auto const alpha_pairs = _mm_unpacklo_epi16(alpha, alpha);
+
+        auto const pixels = _mm_loadu_si128(reinterpret_cast<__m128i const*>(dest + i));
+        auto const blended = _mm_packus_epi16(
+            blend(_mm_unpacklo_epi8(pixels, zero), _mm_unpacklo_epi32(alpha_pairs, alpha_pairs)),
+            blend(_mm_unpackhi_epi8(pixels, zero), _mm_unpackhi_epi32(alpha_pairs, alpha_pairs)));
+
+        _mm_storeu_si128(
+            reinterpret_cast<__m128i*>(dest + i),
+            _mm_or_si128(_mm_andnot_si128(alpha_mask, blended), _mm_and_si128(alpha_mask, pixels)));
+    }
+
+    blend_scalar(dest + i, coverage + i, count - i, colour);
+}
+#endif
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+inline __m256i div255_epi16(__m256i x)
+{
+    return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(x, _mm256_set1_epi16(1)), _mm256_srli_epi16(x, 8)), 8);
+}
+
+__attribute__((target("avx2")))
+void blend_avx2(uint32_t* dest, unsigned char const* coverage, size_t count, uint32_t colour)
+{
+    auto const zero = _mm256_setzero_si256();
+    auto const max = _mm256_set1_epi16(255);
+    auto const colour_alpha = _mm256_set1_epi16(static_cast<short>(colour >> 24));
+    auto const colour_channels = _mm256_unpacklo_epi8(_mm256_set1_epi32(colour), zero);
+    auto const alpha_mask = _mm256_set1_epi32(0xff000000);
+
+    // Unpacking works within each 128 bit half: the low unpack of eight pixels holds pixels 0, 1, 4 and 5 and
+    // the high unpack pixels 2, 3, 6 and 7. These shuffles repeat each pixel's alpha to match.
+    auto const spread_low = _mm256_setr_epi8(
+        0, -1, 0, -1, 0, -1, 0, -1, 4, -1, 4, -1, 4, -1, 4, -1,
+        0, -1, 0, -1, 0, -1, 0, -1, 4, -1, 4, -1, 4, -1, 4, -1);
+    auto const spread_high = _mm256_setr_epi8(
+        8, -1, 8, -1, 8, -1, 8, -1, 12, -1, 12, -1, 12, -1, 12, -1,
+        8, -1, 8, -1, 8, -1, 8, -1, 12, -1, 12, -1, 12, -1, 12, -1);
+
+    auto const blend = [&](__m256i pixels, __m256i alpha) __attribute__((target("avx2")))
+        {
+            return _mm256_add_epi16(
+                div255_epi16(_mm256_mullo_epi16(pixels, _mm256_sub_epi16(max, alpha))),
+                div255_epi16(_mm256_mullo_epi16(colour_channels, alpha)));
+        };
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        int64_t coverage8;
+        memcpy(&coverage8, coverage + i, sizeof(coverage8));
+        if (!coverage8)
+        {
+            continue;
+        }
+
+        // One pixel's alpha in the low byte of each 32 bit lane
+        auto const alpha = div255_epi16(_mm256_mullo_epi16(
+            _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(coverage8)),
+            colour_alpha));
+
+        auto const pixels = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(dest + i));
+        auto const blended = _mm256_packus_epi16(
+            blend(_mm256_unpacklo_epi8(pixels, zero), _mm256_shuffle_epi8(alpha, spread_low)),
+            blend(_mm256_unpackhi_epi8(pixels, zero), _mm256_shuffle_epi8(alpha, spread_high)));
+
+        _mm256_storeu_si256(
+            reinterpret_cast<__m256i*>(dest + i),
+            _mm256_or_si256(_mm256_andnot_si256(alpha_mask, blended), _mm256_and_si256(alpha_mask, pixels)));
+    }
+
+    blend_scalar(dest + i, coverage + i, count - i, colour);
+}
+#endif
+
+#if defined(__ARM_NEON) && !defined(__SSE2__)
+inline uint16x8_t div255_u16(uint16x8_t x)
+{
+    return vshrq_n_u16(vaddq_u16(vaddq_u16(x, vdupq_n_u16(1)), vshrq_n_u16(x, 8)), 8);
+}
+
+void blend_neon(uint32_t* dest, unsigned char const* coverage, size_t count, uint32_t colour)
+{
+    unsigned char colour_bytes[4];
+    memcpy(colour_bytes, &colour, sizeof(colour_bytes));
+
+    auto const colour_alpha = vdup_n_u8(colour_bytes[3]);
+    auto const max = vdup_n_u8(255);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        auto const coverage8 = vld1_u8(coverage + i);
+        if (!vget_lane_u64(vreinterpret_u64_u8(coverage8), 0))
+        {
+            continue;
+        }
+
+        auto const alpha = vmovn_u16(div255_u16(vmull_u8(coverage8, colour_alpha)));
+        auto const inverse_alpha = vsub_u8(max, alpha);
+
+        // De-interleaves the eight pixels into one vector per channel
+        auto const pixels = reinterpret_cast<uint8_t*>(dest + i);
+        auto channels = vld4_u8(pixels);
+
+        for (int c = 0; c != 3; ++c)
+        {
+            channels.val[c] = vmovn_u16(vaddq_u16(
+                div255_u16(vmull_u8(channels.val[c], inverse_alpha)),
+                div255_u16(vmull_u8(vdup_n_u8(colour_bytes[c]), alpha))));
+        }
+
+        vst4_u8(pixels, channels);
+    }
+
+    blend_scalar(dest + i, coverage + i, count - i, colour);
+}
+#endif
+
+auto select_blend_implementation() -> BlendImplementation
+{
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return {&blend_avx2, "avx2"};
+    }
+#endif
+
+#if defined(__SSE2__)
+    return {&blend_sse2, "sse2"};
+#elif defined(__ARM_NEON)
+    return {&blend_neon, "neon"};
+#else
+    return {&blend_scalar, "scalar"};
+#endif
+}
+
+auto blend_implementation() -> BlendImplementation const&
+{
+    static BlendImplementation const implementation = select_blend_implementation();
+    return implementation;
+}
+}
+
+void fill_pixels(uint32_t* dest, size_t count, uint32_t pixel)
+{
+    fill_implementation().fill(dest, count, pixel);
+}
+
+auto fill_pixels_implementation() -> char const*
+{
+    return fill_implementation().name;
+}
+
+void blend_coverage(uint32_t* dest, unsigned char const* coverage, size_t count, uint32_t colour)
+{
+    blend_implementation().blend(dest, coverage, count, colour);
+}
+
+auto blend_coverage_implementation() -> char const*
+{
+    return blend_implementation().name;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_PIXEL_KERNELS_H
+#define FRAME_PIXEL_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// Writes count copies of pixel starting at dest.
+/// The widest store available on the running CPU (AVX2, SSE2 or NEON) is selected on first use.
+void fill_pixels(uint32_t* dest, size_t count, uint32_t pixel);
+
+/// The name of the implementation selected by fill_pixels() ("avx2", "sse2", "neon" or "scalar")
+auto fill_pixels_implementation() -> char const*;
+
+/// Blends colour onto count ARGB8888 pixels starting at dest, weighting each pixel by the corresponding A8 value in
+/// coverage multiplied by colour's alpha. The alpha of dest is left unchanged.
+/// colour is given as a pixel: its bytes in memory are blue, green, red and alpha.
+/// Every implementation produces the same result as the scalar one, which rounds each product down.
+void blend_coverage(uint32_t* dest, unsigned char const* coverage, size_t count, uint32_t colour);
+
+/// The name of the implementation selected by blend_coverage() ("avx2", "sse2", "neon" or "scalar")
+auto blend_coverage_implementation() -> char const*;
+
+#endif // FRAME_PIXEL_KERNELS_H
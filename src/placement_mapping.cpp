@@ -0,0 +1,107 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "placement_mapping.h"
+
+#include <algorithm>
+
+void egmde::PlacementMapping::update(
+    int output_id,
+    std::optional<std::string> const& title,
+    std::optional<std::string> const& snap_name)
+{
+    clear(output_id);
+
+    if (!title && !snap_name)
+    {
+        return;
+    }
+
+    if (title)
+    {
+        add(surface_title_to_output_ids, *title, output_id);
+    }
+
+    if (snap_name)
+    {
+        add(snap_name_to_output_ids, *snap_name, output_id);
+    }
+
+    output_id_to_claims.emplace(output_id, Claims{title, snap_name});
+}
+
+void egmde::PlacementMapping::clear(int output_id)
+{
+    auto const claims = output_id_to_claims.find(output_id);
+    if (claims == output_id_to_claims.end())
+    {
+        return;
+    }
+
+    if (claims->second.title)
+    {
+        remove(surface_title_to_output_ids, *claims->second.title, output_id);
+    }
+
+    if (claims->second.snap_name)
+    {
+        remove(snap_name_to_output_ids, *claims->second.snap_name, output_id);
+    }
+
+    output_id_to_claims.erase(claims);
+}
+
+auto egmde::PlacementMapping::output_for_surface(std::string_view title) const -> std::optional<int>
+{
+    return find(surface_title_to_output_ids, title);
+}
+
+auto egmde::PlacementMapping::output_for_snap(std::string_view snap_name) const -> std::optional<int>
+{
+    return find(snap_name_to_output_ids, snap_name);
+}
+
+void egmde::PlacementMapping::add(NameToOutputIds& index, std::string const& name, int output_id)
+{
+    index[name].push_back(output_id);
+}
+
+void egmde::PlacementMapping::remove(NameToOutputIds& index, std::string const& name, int output_id)
+{
+    auto const entry = index.find(name);
+    if (entry == index.end())
+    {
+        return;
+    }
+
+    auto& output_ids = entry->second;
+    output_ids.erase(std::remove(begin(output_ids), end(output_ids), output_id), end(output_ids));
+
+    if (output_ids.empty())
+    {
+        index.erase(entry);
+    }
+}
+
+auto egmde::PlacementMapping::find(NameToOutputIds const& index, std::string_view name) -> std::optional<int>
+{
+    if (auto const entry = index.find(name); entry != index.end())
+    {
+        return entry->second.front();
+    }
+
+    return std::nullopt;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_PLACEMENT_MAPPING_H
+#define FRAME_PLACEMENT_MAPPING_H
+
+#include "string_hash.h"
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace egmde
+{
+/// The outputs that surface titles and snap names are assigned to (by output attributes). Where several outputs
+/// claim the same name, the one that claimed it first is used.
+class PlacementMapping
+{
+public:
+    /// Replaces whatever output_id claimed with title and snap_name
+    void update(int output_id, std::optional<std::string> const& title, std::optional<std::string> const& snap_name);
+    void clear(int output_id);
+
+    auto output_for_surface(std::string_view title) const -> std::optional<int>;
+    auto output_for_snap(std::string_view snap_name) const -> std::optional<int>;
+
+private:
+    /// The outputs claiming each name, in the order they did so
+    using NameToOutputIds = StringMap<std::vector<int>>;
+
+    struct Claims
+    {
+        std::optional<std::string> title;
+        std::optional<std::string> snap_name;
+    };
+
+    static void add(NameToOutputIds& index, std::string const& name, int output_id);
+    static void remove(NameToOutputIds& index, std::string const& name, int output_id);
+    static auto find(NameToOutputIds const& index, std::string_view name) -> std::optional<int>;
+
+    NameToOutputIds surface_title_to_output_ids;
+    NameToOutputIds snap_name_to_output_ids;
+    std::unordered_map<int, Claims> output_id_to_claims;
+};
+}
+
+#endif //FRAME_PLACEMENT_MAPPING_H
@@ -0,0 +1,177 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "reactor.h"
+
+#include <boost/throw_exception.hpp>
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iterator>
+#include <system_error>
+
+egmde::Reactor::Reactor() :
+    epoll_fd{epoll_create1(EPOLL_CLOEXEC)}
+{
+    if (epoll_fd < 0)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to create epoll instance"}));
+    }
+}
+
+egmde::Reactor::~Reactor() = default;
+
+void egmde::Reactor::add_fd(int fd, uint32_t events, Handler handler)
+{
+    std::lock_guard lock{mutex};
+
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to add fd to epoll"}));
+    }
+
+    handlers[fd] = std::make_shared<Handler>(std::move(handler));
+}
+
+void egmde::Reactor::modify_fd(int fd, uint32_t events)
+{
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event) == -1)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to modify fd in epoll"}));
+    }
+}
+
+void egmde::Reactor::remove_fd(int fd)
+{
+    std::lock_guard lock{mutex};
+
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    handlers.erase(fd);
+}
+
+void egmde::Reactor::dispatch(std::optional<std::chrono::milliseconds> timeout)
+{
+    epoll_event events[16];
+
+    auto const ready = epoll_wait(epoll_fd, events, std::size(events), timeout ? timeout->count() : -1);
+    if (ready == -1)
+    {
+        if (errno == EINTR)
+            return;
+
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to wait for event"}));
+    }
+
+    for (auto i = 0; i != ready; ++i)
+    {
+        std::shared_ptr<Handler> handler;
+        {
+            std::lock_guard lock{mutex};
+            if (auto const registered = handlers.find(events[i].data.fd); registered != handlers.end())
+            {
+                handler = registered->second;
+            }
+        }
+
+        // A handler earlier in this batch may have removed this source
+        if (handler)
+        {
+            (*handler)(events[i].events);
+        }
+    }
+}
+
+egmde::Reactor::Timer::Timer(Reactor& reactor, std::function<void()> handler) :
+    reactor{reactor},
+    fd{timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)}
+{
+    if (fd < 0)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to create timer"}));
+    }
+
+    reactor.add_fd(fd, EPOLLIN | EPOLLET, [this, handler = std::move(handler)](uint32_t)
+        {
+            // Finds nothing to read if the timer has been disarmed or rearmed since it expired
+            uint64_t expirations;
+            if (read(fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+            {
+                handler();
+            }
+        });
+}
+
+egmde::Reactor::Timer::~Timer()
+{
+    reactor.remove_fd(fd);
+}
+
+void egmde::Reactor::Timer::arm(std::chrono::milliseconds delay)
+{
+    // A zero expiry would disarm the timer rather than fire it straight away
+    auto const expiry = std::max<std::chrono::nanoseconds>(delay, std::chrono::nanoseconds{1});
+    itimerspec const spec
+    {
+        {0, 0},
+        {
+            std::chrono::duration_cast<std::chrono::seconds>(expiry).count(),
+            (expiry % std::chrono::seconds{1}).count()
+        }
+    };
+
+    if (timerfd_settime(fd, 0, &spec, nullptr) == -1)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to set timer"}));
+    }
+}
+
+void egmde::Reactor::Timer::disarm()
+{
+    itimerspec const spec{};
+
+    if (timerfd_settime(fd, 0, &spec, nullptr) == -1)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to disarm timer"}));
+    }
+}
+
+auto egmde::Reactor::Timer::remaining() const -> std::optional<std::chrono::nanoseconds>
+{
+    itimerspec spec;
+
+    if (timerfd_gettime(fd, &spec) == -1)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to read timer"}));
+    }
+
+    if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+    {
+        return std::nullopt;
+    }
+
+    return std::chrono::seconds{spec.it_value.tv_sec} + std::chrono::nanoseconds{spec.it_value.tv_nsec};
+}
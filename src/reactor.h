@@ -0,0 +1,89 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_REACTOR_H
+#define FRAME_REACTOR_H
+
+#include <mir/fd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+namespace egmde
+{
+/// An epoll based event loop. Handlers run on the thread calling dispatch(), but sources can be added and removed
+/// from any thread.
+class Reactor
+{
+public:
+    Reactor();
+    ~Reactor();
+
+    Reactor(Reactor const&) = delete;
+    Reactor& operator=(Reactor const&) = delete;
+
+    using Handler = std::function<void(uint32_t events)>;
+
+    /// Calls handler with the ready events whenever fd is ready for any of events (EPOLLIN, EPOLLOUT...). With
+    /// EPOLLET, handler is only called as fd becomes ready, so must drain it.
+    void add_fd(int fd, uint32_t events, Handler handler);
+    void modify_fd(int fd, uint32_t events);
+    void remove_fd(int fd);
+
+    class Timer;
+
+    /// Waits until a source is ready (or timeout passes) and calls the handlers of those that are
+    void dispatch(std::optional<std::chrono::milliseconds> timeout = std::nullopt);
+
+private:
+    mir::Fd const epoll_fd;
+
+    std::mutex mutex;
+    std::map<int, std::shared_ptr<Handler>> handlers;  // By fd
+};
+
+/// A timer, measured by CLOCK_MONOTONIC, that calls its handler from reactor's dispatch() each time it expires.
+/// It keeps one timerfd for its lifetime, rearmed and disarmed (from any thread) as needed.
+class Reactor::Timer
+{
+public:
+    Timer(Reactor& reactor, std::function<void()> handler);
+    ~Timer();
+
+    Timer(Timer const&) = delete;
+    Timer& operator=(Timer const&) = delete;
+
+    /// Fires once, delay from now, replacing any expiry already set
+    void arm(std::chrono::milliseconds delay);
+
+    /// Cancels the expiry set, including one that has passed without its handler having been called yet
+    void disarm();
+
+    /// The time left until the timer fires, or nullopt if it isn't armed
+    auto remaining() const -> std::optional<std::chrono::nanoseconds>;
+
+private:
+    Reactor& reactor;
+    mir::Fd const fd;
+};
+}
+
+#endif //FRAME_REACTOR_H
@@ -0,0 +1,374 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "shm_arena.h"
+
+#include <wayland-client.h>
+
+#include <mir/log.h>
+
+#include <boost/throw_exception.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+namespace
+{
+auto open_shm_file() -> mir::Fd
+{
+    static auto (*open_file)() -> mir::Fd = []
+    {
+        static char const* shm_dir;
+        open_file = []{ return mir::Fd{open(shm_dir, O_TMPFILE | O_RDWR | O_EXCL, S_IRWXU)}; };
+
+        // Wayland based toolkits typically use $XDG_RUNTIME_DIR to open shm pools
+        // so we try that before "/dev/shm". But confined snaps can't access "/dev/shm"
+        // so we try "/tmp" if both of the above fail.
+        for (auto dir : {const_cast<const char*>(getenv("XDG_RUNTIME_DIR")), "/dev/shm", "/tmp" })
+        {
+            if (dir)
+            {
+                shm_dir = dir;
+                auto fd = open_file();
+                if (fd >= 0)
+                    return fd;
+            }
+        }
+        return mir::Fd{};
+    };
+
+    return open_file();
+}
+
+auto aligned(size_t size) -> size_t
+{
+    auto const alignment = egmde::ArenaRanges::alignment;
+    return (size + alignment - 1) / alignment * alignment;
+}
+}
+
+auto egmde::ArenaRanges::allocate(size_t size) -> std::optional<size_t>
+{
+    size = aligned(size);
+
+    for (auto range = free_ranges.begin(); range != free_ranges.end(); ++range)
+    {
+        auto const [offset, range_size] = *range;
+        if (range_size >= size)
+        {
+            free_ranges.erase(range);
+            if (range_size > size)
+            {
+                free_ranges.emplace(offset + size, range_size - size);
+            }
+
+            allocated.emplace(offset, size);
+            allocated_size += size;
+            return offset;
+        }
+    }
+
+    return std::nullopt;
+}
+
+void egmde::ArenaRanges::free(size_t offset)
+{
+    auto const allocation = allocated.find(offset);
+    if (allocation == allocated.end())
+    {
+        BOOST_THROW_EXCEPTION(std::logic_error("Freeing a range that isn't allocated"));
+    }
+
+    auto size = allocation->second;
+    allocated.erase(allocation);
+    allocated_size -= size;
+
+    // Merge with the free ranges either side
+    auto const next = free_ranges.find(offset + size);
+    if (next != free_ranges.end())
+    {
+        size += next->second;
+        free_ranges.erase(next);
+    }
+
+    auto const following = free_ranges.lower_bound(offset);
+    if (following != free_ranges.begin())
+    {
+        auto const previous = std::prev(following);
+        if (previous->first + previous->second == offset)
+        {
+            previous->second += size;
+            return;
+        }
+    }
+
+    free_ranges.emplace(offset, size);
+}
+
+void egmde::ArenaRanges::grow(size_t new_capacity)
+{
+    if (new_capacity <= total_size)
+    {
+        return;
+    }
+
+    if (!free_ranges.empty())
+    {
+        auto& [last_offset, last_size] = *free_ranges.rbegin();
+        if (last_offset + last_size == total_size)
+        {
+            last_size += new_capacity - total_size;
+            total_size = new_capacity;
+            return;
+        }
+    }
+
+    free_ranges.emplace(total_size, new_capacity - total_size);
+    total_size = new_capacity;
+}
+
+auto egmde::ArenaRanges::shortfall(size_t size) const -> size_t
+{
+    size = aligned(size);
+
+    if (!free_ranges.empty())
+    {
+        auto const& [last_offset, last_size] = *free_ranges.rbegin();
+        if (last_offset + last_size == total_size)
+        {
+            return size > last_size ? size - last_size : 0;
+        }
+    }
+
+    return size;
+}
+
+auto egmde::ArenaRanges::largest_free_range() const -> size_t
+{
+    size_t largest = 0;
+    for (auto const& [_, size] : free_ranges)
+    {
+        largest = std::max(largest, size);
+    }
+    return largest;
+}
+
+class egmde::ShmArena::Pool
+{
+public:
+    explicit Pool(wl_shm* shm) : shm{shm} {}
+    ~Pool();
+
+    void grow(size_t new_capacity);
+
+    wl_shm* const shm;
+    mir::Fd fd;
+    void* mapping = nullptr;
+    wl_shm_pool* shm_pool = nullptr;
+    ArenaRanges ranges;
+};
+
+egmde::ShmArena::Pool::~Pool()
+{
+    if (shm_pool)
+        wl_shm_pool_destroy(shm_pool);
+
+    if (mapping && munmap(mapping, ranges.capacity()))
+        mir::log_error("munmap() failed in %s: %s", __PRETTY_FUNCTION__, strerror(errno));
+}
+
+void egmde::ShmArena::Pool::grow(size_t new_capacity)
+{
+    auto const capacity = ranges.capacity();
+
+    if (fd < 0)
+    {
+        fd = open_shm_file();
+
+        if (fd < 0)
+        {
+            BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to open shm buffer"}));
+        }
+    }
+
+    if (auto error = posix_fallocate(fd, capacity, new_capacity - capacity))
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{error, std::system_category(), "Failed to allocate shm buffer"}));
+    }
+
+    auto const new_mapping = mapping ?
+        mremap(mapping, capacity, new_capacity, MREMAP_MAYMOVE) :
+        mmap(nullptr, new_capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (new_mapping == MAP_FAILED)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to mmap buffer"}));
+    }
+
+    mapping = new_mapping;
+
+    if (shm_pool)
+    {
+        wl_shm_pool_resize(shm_pool, new_capacity);
+    }
+    else if (shm)
+    {
+        shm_pool = wl_shm_create_pool(shm, fd, new_capacity);
+    }
+
+    ranges.grow(new_capacity);
+}
+
+auto egmde::ShmArena::Stats::fragmentation() const -> double
+{
+    auto const bytes_free = bytes_mapped - bytes_allocated;
+    return bytes_free ? 1.0 - double(largest_free_range) / bytes_free : 0.0;
+}
+
+egmde::ShmArena::ShmArena(wl_shm* shm, size_t min_reclaimable) :
+    shm{shm},
+    min_reclaimable{min_reclaimable}
+{
+    pools.push_back(std::make_unique<Pool>(shm));
+}
+
+egmde::ShmArena::~ShmArena()
+{
+    for (auto const& [buffer, _] : retired)
+    {
+        wl_buffer_destroy(buffer);
+    }
+}
+
+auto egmde::ShmArena::allocate(size_t size) -> Allocation
+{
+    auto& pool = *pools.back();
+    auto offset = pool.ranges.allocate(size);
+
+    ++total_allocations;
+
+    if (!offset)
+    {
+        // Growing by at least half again keeps the number of resizes logarithmic in the final size
+        auto const capacity = pool.ranges.capacity();
+        pool.grow(std::max(capacity + pool.ranges.shortfall(size), capacity + capacity / 2));
+        offset = pool.ranges.allocate(size);
+
+        log_stats("grown");
+    }
+
+    return {&pool, offset.value()};
+}
+
+void egmde::ShmArena::free(Allocation const& allocation)
+{
+    auto& ranges = allocation.pool->ranges;
+    ranges.free(allocation.offset);
+
+    if (is_stale(allocation))
+    {
+        if (ranges.allocation_count() == 0)
+        {
+            std::erase_if(pools, [&](auto const& pool) { return pool.get() == allocation.pool; });
+            log_stats("released a stale pool");
+        }
+    }
+    else if (ranges.allocated_bytes() < ranges.capacity() / 4 &&
+             ranges.capacity() - ranges.allocated_bytes() >= min_reclaimable)
+    {
+        // wl_shm_pool can't shrink, so move allocations to a fresh pool as their owners reallocate
+        if (ranges.allocation_count() == 0)
+        {
+            pools.pop_back();
+        }
+        pools.push_back(std::make_unique<Pool>(shm));
+        log_stats("moved to a fresh pool");
+    }
+}
+
+auto egmde::ShmArena::create_buffer(
+    Allocation const& allocation, int32_t width, int32_t height, int32_t stride, uint32_t format) -> wl_buffer*
+{
+    return wl_shm_pool_create_buffer(allocation.pool->shm_pool, allocation.offset, width, height, stride, format);
+}
+
+auto egmde::ShmArena::data(Allocation const& allocation) const -> unsigned char*
+{
+    return static_cast<unsigned char*>(allocation.pool->mapping) + allocation.offset;
+}
+
+auto egmde::ShmArena::is_stale(Allocation const& allocation) const -> bool
+{
+    return allocation.pool != pools.back().get();
+}
+
+void egmde::ShmArena::retire(wl_buffer* buffer, Allocation const& allocation)
+{
+    retired.emplace(buffer, allocation);
+}
+
+auto egmde::ShmArena::release(wl_buffer* buffer) -> bool
+{
+    auto const retiree = retired.find(buffer);
+    if (retiree == retired.end())
+    {
+        return false;
+    }
+
+    auto const allocation = retiree->second;
+    retired.erase(retiree);
+
+    wl_buffer_destroy(buffer);
+    free(allocation);
+    return true;
+}
+
+auto egmde::ShmArena::stats() const -> Stats
+{
+    Stats result{0, 0, 0, 0, total_allocations, pools.size(), retired.size()};
+
+    for (auto const& pool : pools)
+    {
+        result.bytes_mapped += pool->ranges.capacity();
+        result.bytes_allocated += pool->ranges.allocated_bytes();
+        result.largest_free_range = std::max(result.largest_free_range, pool->ranges.largest_free_range());
+        result.live_allocations += pool->ranges.allocation_count();
+    }
+
+    return result;
+}
+
+void egmde::ShmArena::log_stats(char const* event) const
+{
+    auto const current = stats();
+    mir::log_info(
+        "Shm arena %s: %zu bytes mapped in %zu pools, %zu bytes in %zu buffers (%zu retired, %zu allocations in "
+        "total), %.0f%% of free space fragmented",
+        event,
+        current.bytes_mapped,
+        current.pools,
+        current.bytes_allocated,
+        current.live_allocations,
+        current.retired_buffers,
+        current.total_allocations,
+        100 * current.fragmentation());
+}
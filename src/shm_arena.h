@@ -0,0 +1,136 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_SHM_ARENA_H
+#define FRAME_SHM_ARENA_H
+
+#include <mir/fd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <vector>
+
+struct wl_buffer;
+struct wl_shm;
+struct wl_shm_pool;
+
+namespace egmde
+{
+/// First fit allocation of ranges within [0, capacity), merging ranges as they are freed
+class ArenaRanges
+{
+public:
+    /// The offset of a newly allocated range of size bytes, or nullopt if no free range is large enough
+    auto allocate(size_t size) -> std::optional<size_t>;
+
+    /// Returns the range allocated at offset to the free list
+    void free(size_t offset);
+
+    /// Extends the arena to new_capacity (which must not be less than capacity())
+    void grow(size_t new_capacity);
+
+    /// The bytes needed at the end of the arena before a range of size bytes will fit
+    auto shortfall(size_t size) const -> size_t;
+
+    auto capacity() const -> size_t { return total_size; }
+    auto allocated_bytes() const -> size_t { return allocated_size; }
+    auto allocation_count() const -> size_t { return allocated.size(); }
+    auto largest_free_range() const -> size_t;
+
+    /// Allocations are rounded up to a multiple of this, keeping every range cache line aligned
+    static size_t const alignment = 64;
+
+private:
+    size_t total_size = 0;
+    size_t allocated_size = 0;
+    std::map<size_t, size_t> free_ranges;   // Offset to size
+    std::map<size_t, size_t> allocated;     // Offset to size
+};
+
+/// The shm files and wl_shm_pools from which every buffer the client draws into is allocated. New allocations come
+/// from the current pool, which grows as needed. Growing may move its mapping, so data() is reread after allocating.
+/// When most of the current pool is free, the arena moves on to a fresh one, and unmaps the old pool once every
+/// allocation from it has been freed.
+class ShmArena
+{
+public:
+    /// \param shm may be null for an arena that only maps memory, without creating wl_shm_pools
+    /// \param min_reclaimable the arena moves to a fresh pool when under a quarter of the current one is allocated,
+    ///        and at least this much of it is free
+    explicit ShmArena(wl_shm* shm, size_t min_reclaimable = 64 * 1024 * 1024);
+    ~ShmArena();
+
+    ShmArena(ShmArena const&) = delete;
+    ShmArena& operator=(ShmArena const&) = delete;
+
+    class Pool;
+
+    struct Allocation
+    {
+        Pool* pool = nullptr;
+        size_t offset = 0;
+    };
+
+    /// Allocates size bytes, growing the current shm file and pool if there is no free range large enough
+    auto allocate(size_t size) -> Allocation;
+    void free(Allocation const& allocation);
+
+    auto create_buffer(Allocation const& allocation, int32_t width, int32_t height, int32_t stride, uint32_t format)
+        -> wl_buffer*;
+    auto data(Allocation const& allocation) const -> unsigned char*;
+
+    /// Whether allocation is from a pool the arena has moved on from, which is unmapped once nothing uses it
+    auto is_stale(Allocation const& allocation) const -> bool;
+    auto has_stale_pools() const -> bool { return pools.size() > 1; }
+
+    /// Takes a buffer its owner is done with but the compositor may still be reading, destroying it and freeing its
+    /// allocation once the compositor releases it
+    void retire(wl_buffer* buffer, Allocation const& allocation);
+
+    /// Handles the release of a retired buffer. Returns false if buffer isn't retired.
+    auto release(wl_buffer* buffer) -> bool;
+
+    struct Stats
+    {
+        size_t bytes_mapped;
+        size_t bytes_allocated;
+        size_t largest_free_range;
+        size_t live_allocations;
+        size_t total_allocations;
+        size_t pools;
+        size_t retired_buffers;
+
+        /// The proportion of free bytes outside the largest free range: 0 when the free space is contiguous
+        auto fragmentation() const -> double;
+    };
+
+    auto stats() const -> Stats;
+
+private:
+    void log_stats(char const* event) const;
+
+    wl_shm* const shm;
+    size_t const min_reclaimable;
+    std::vector<std::unique_ptr<Pool>> pools;   // The last is current, any others are stale
+    std::map<wl_buffer*, Allocation> retired;
+    size_t total_allocations = 0;
+};
+}
+
+#endif //FRAME_SHM_ARENA_H
@@ -23,11 +23,64 @@
 #include <cstring>
 #include <fstream>
 
-namespace
+auto egmde::snap_identity_from(std::string const& text, std::string const& prefix, char app_separator) -> SnapIdentity
 {
+    if (!text.starts_with(prefix))
+    {
+        return {};
+    }
+
+    auto const after_snap_prefix = begin(text) + prefix.size();
+    auto const before_app_suffix = std::find(after_snap_prefix, end(text), app_separator);
+
+    // We also need to discard any parallel-install suffix (which starts with an underscore)
+    auto const install_suffix = std::find(after_snap_prefix, before_app_suffix, '_');
+
+    return {std::string{after_snap_prefix, install_suffix}, std::string{after_snap_prefix, before_app_suffix}};
+}
+
+egmde::SnapIdentityCache::SnapIdentityCache(Identify identify) :
+    identify{std::move(identify)}
+{
+}
+
+auto egmde::SnapIdentityCache::identity_of(miral::Application const& app) -> SnapIdentity
+{
+    {
+        std::lock_guard lock{mutex};
+        if (auto const known = identities.find(app.get()); known != identities.end())
+        {
+            if (known->second.first.lock() == app)
+            {
+                return known->second.second;
+            }
+        }
+    }
 
+    // Identify without holding the lock, as that makes system calls
+    auto const identity = identify(app);
+    if (!identity)
+    {
+        return {};
+    }
+
+    std::lock_guard lock{mutex};
+    std::erase_if(identities, [](auto const& entry) { return entry.second.first.expired(); });
+    identities.insert_or_assign(app.get(), std::pair{std::weak_ptr{app}, identity.value()});
+    return identity.value();
+}
+
+void egmde::SnapIdentityCache::forget(miral::Application const& app)
+{
+    std::lock_guard lock{mutex};
+    identities.erase(app.get());
 }
-auto snap_name_of(miral::Application const& app, bool fallback_without_apparmor, bool strip_parellel) -> std::string
+
+namespace
+{
+using egmde::SnapIdentity;
+
+auto identify(miral::Application const& app) -> std::optional<SnapIdentity>
 {
     int const app_fd = miral::socket_fd_of(app);
     char* label_cstr;
@@ -35,7 +88,7 @@ auto snap_name_of(miral::Application const& app, bool fallback_without_apparmor,
     errno = 0;
     if (app_fd < 0)
     {
-        return "";
+        return std::nullopt;
     }
     else if (aa_getpeercon(app_fd, &label_cstr, &mode_cstr) < 0)
     {
@@ -43,7 +96,7 @@ auto snap_name_of(miral::Application const& app, bool fallback_without_apparmor,
 
         // EINVAL is what is returned when AppArmor isn't setup
         // ENOPROTOOPT is what is returned when AppArmor doesn't have some Ubuntu patches (yet)
-        if (((errno == EINVAL) || errno == ENOPROTOOPT) && fallback_without_apparmor)
+        if ((errno == EINVAL) || errno == ENOPROTOOPT)
         {
             mir::log_info("Fall back (without AppArmor): Identify client via /proc/%%d/cmdline");
 
@@ -51,28 +104,15 @@ auto snap_name_of(miral::Application const& app, bool fallback_without_apparmor,
             if (std::ifstream cmdline{"/proc/" + std::to_string(miral::pid_of(app)) + "/cmdline"})
             {
                 std::string const path{std::istreambuf_iterator{cmdline}, std::istreambuf_iterator<char>{}};
-                std::string const snap_prefix{"/snap/"};
-
-                if (path.starts_with(snap_prefix))
-                {
-                    // Strip the prefix (after_snap_prefix) and app name (before_app_suffix) from the path
-                    auto const after_snap_prefix = begin(path) + snap_prefix.size();
-                    auto const before_app_suffix = std::find(after_snap_prefix, end(path), '/');
-
-                    // We also need to discard any parallel-install suffix (which starts with an underscore)
-                    if (strip_parellel)
-                    {
-                        auto const install_suffix = std::find(after_snap_prefix, before_app_suffix, '_');
-                        return std::string{after_snap_prefix, install_suffix};
-                    }
-                    else
-                    {
-                        return std::string{after_snap_prefix, before_app_suffix};
-                    }
-                }
+
+                auto identity = egmde::snap_identity_from(path, "/snap/", '/');
+                identity.from_cmdline = true;
+                return identity;
             }
         }
-        return "";
+
+        // Any other failure might not happen next time, so isn't taken as the app not being from a snap
+        return std::nullopt;
     }
     else
     {
@@ -80,39 +120,37 @@ auto snap_name_of(miral::Application const& app, bool fallback_without_apparmor,
         free(label_cstr);
         // mode_cstr should NOT be freed, as it's from the same buffer as label_cstr
 
-        std::string const snap_prefix{"snap."};
-        if (label.starts_with(snap_prefix))
-        {
-            // Strip the prefix (after_snap_prefix) and app name (before_app_suffix) from the label
-            auto const after_snap_prefix = begin(label) + snap_prefix.size();
-            auto const before_app_suffix = std::find(after_snap_prefix, end(label), '.');
-
-            // We also need to discard any parallel-install suffix (which starts with an underscore)
-            auto const install_suffix = std::find(after_snap_prefix, before_app_suffix, '_');
-
-            // We also need to discard any parallel-install suffix (which starts with an underscore)
-            if (strip_parellel)
-            {
-                return std::string{after_snap_prefix, install_suffix};
-            }
-            else
-            {
-                return std::string{after_snap_prefix, before_app_suffix};
-            }
-        }
-        else
-        {
-            return "";
-        }
+        auto identity = egmde::snap_identity_from(label, "snap.", '.');
+        identity.label = label;
+        return identity;
     }
 }
 
+egmde::SnapIdentityCache identity_cache{identify};
+}
+
 auto snap_name_of(miral::Application const& app, bool fallback_without_apparmor) -> std::string
 {
-    return snap_name_of(app, fallback_without_apparmor, true);
+    auto const identity = identity_cache.identity_of(app);
+    return !identity.from_cmdline || fallback_without_apparmor ? identity.snap_name : "";
 }
 
 auto snap_instance_name_of(miral::Application const& app) -> std::string
 {
-    return snap_name_of(app, true, false);
+    return identity_cache.identity_of(app).instance_name;
+}
+
+auto apparmor_label_of(miral::Application const& app) -> std::string
+{
+    return identity_cache.identity_of(app).label;
+}
+
+void remember_snap_identity(miral::Application const& app)
+{
+    identity_cache.identity_of(app);
+}
+
+void forget_snap_identity(miral::Application const& app)
+{
+    identity_cache.forget(app);
 }
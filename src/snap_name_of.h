@@ -19,9 +19,60 @@
 
 #include <miral/application.h>
 
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <unordered_map>
 
+/// The snap app belongs to, or "" if it isn't from a snap. Each app is only identified once: the result is kept
+/// until forget_snap_identity() is called for it.
 auto snap_name_of(miral::Application const& app, bool fallback_without_apparmor) -> std::string;
 auto snap_instance_name_of(miral::Application const& app) -> std::string;
 
+/// The AppArmor label app is confined by, or "" if that couldn't be read
+auto apparmor_label_of(miral::Application const& app) -> std::string;
+
+/// Identifies app ahead of its first query (when it connects, say)
+void remember_snap_identity(miral::Application const& app);
+
+/// Drops what is known of app, once it has disconnected
+void forget_snap_identity(miral::Application const& app);
+
+namespace egmde
+{
+struct SnapIdentity
+{
+    std::string snap_name;          // Without any parallel install suffix
+    std::string instance_name;      // With it
+    bool from_cmdline = false;      // Identified via /proc/<pid>/cmdline, as AppArmor isn't available
+    std::string label{};            // The AppArmor label identified by, unless from_cmdline
+};
+
+/// Strips the prefix and app name from an AppArmor label ("snap.<instance>.<app>") or a path ("/snap/<instance>/...")
+auto snap_identity_from(std::string const& text, std::string const& prefix, char app_separator) -> SnapIdentity;
+
+/// Identities by session, kept until forgotten
+class SnapIdentityCache
+{
+public:
+    /// Identifies app, or returns nullopt if that failed in a way that may not recur (so shouldn't be cached)
+    using Identify = std::function<std::optional<SnapIdentity>(miral::Application const& app)>;
+
+    explicit SnapIdentityCache(Identify identify);
+
+    auto identity_of(miral::Application const& app) -> SnapIdentity;
+    void forget(miral::Application const& app);
+
+private:
+    Identify const identify;
+
+    // As a session's address can be reused once it has gone, each entry also holds a weak reference to check that
+    // it is still the session identified
+    std::mutex mutex;
+    std::unordered_map<mir::scene::Session const*, std::pair<std::weak_ptr<mir::scene::Session>, SnapIdentity>> identities;
+};
+}
+
 #endif // FRAME_SNAP_NAME_OF_H
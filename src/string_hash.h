@@ -0,0 +1,38 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_STRING_HASH_H
+#define FRAME_STRING_HASH_H
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace egmde
+{
+/// Hashes strings and string_views alike, so that lookups by string_view needn't construct a string
+struct StringHash
+{
+    using is_transparent = void;
+    auto operator()(std::string_view s) const -> size_t { return std::hash<std::string_view>{}(s); }
+};
+
+template<typename Value>
+using StringMap = std::unordered_map<std::string, Value, StringHash, std::equal_to<>>;
+}
+
+#endif //FRAME_STRING_HASH_H
@@ -0,0 +1,74 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame_pacer.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace testing;
+using namespace std::chrono_literals;
+using egmde::FramePacer;
+
+namespace
+{
+auto const start = FramePacer::Clock::time_point{} + 1h;
+}
+
+TEST(FramePacer, doesnt_wait_before_a_frame_callback_is_requested)
+{
+    FramePacer const pacer{100ms};
+
+    EXPECT_FALSE(pacer.waiting(start));
+    EXPECT_THAT(pacer.wait_left(start), Eq(std::nullopt));
+}
+
+TEST(FramePacer, waits_for_a_requested_frame_callback)
+{
+    FramePacer pacer{100ms};
+    pacer.requested(start);
+
+    EXPECT_TRUE(pacer.waiting(start + 50ms));
+    EXPECT_THAT(pacer.wait_left(start + 50ms), Optional(Eq(FramePacer::Clock::duration{50ms})));
+}
+
+TEST(FramePacer, stops_waiting_when_the_frame_callback_arrives)
+{
+    FramePacer pacer{100ms};
+    pacer.requested(start);
+    pacer.done();
+
+    EXPECT_FALSE(pacer.waiting(start + 1ms));
+}
+
+TEST(FramePacer, gives_up_on_a_frame_callback_that_never_arrives)
+{
+    FramePacer pacer{100ms};
+    pacer.requested(start);
+
+    EXPECT_TRUE(pacer.waiting(start + 99ms));
+    EXPECT_FALSE(pacer.waiting(start + 100ms));
+    EXPECT_THAT(pacer.wait_left(start + 100ms), Eq(std::nullopt));
+}
+
+TEST(FramePacer, waits_afresh_for_each_frame_callback_requested)
+{
+    FramePacer pacer{100ms};
+    pacer.requested(start);
+    pacer.requested(start + 150ms);
+
+    EXPECT_TRUE(pacer.waiting(start + 200ms));
+}
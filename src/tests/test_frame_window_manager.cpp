@@ -150,3 +150,242 @@ TEST_F(FrameWindowManagerWithSurfaceTitleInDisplayConfig, WindowsCanBePlacedExac
     EXPECT_THAT(window.top_left(), Eq(geom::Point{100, 100}));
     EXPECT_THAT(window.size(), Eq(geom::Size{50, 50}));
 }
+
+class FrameWindowManagerWithSeveralTilesInDisplayConfig : public FrameWindowManagerTest
+{
+protected:
+    FrameWindowManagerWithSeveralTilesInDisplayConfig()
+        : display_config(write_and_build_display_config(
+            "/tmp/test.display",
+            R"(
+layouts:
+  default:
+    cards:
+    - card-id: 0
+      VGA-1:
+        state: enabled
+        mode: 800x600@60.0
+    applications:
+    - snap-name: not-a-snap
+      position: [ 0, 0 ]
+      size: [ 10, 10 ]
+    - surface-title: clock
+      position: [ 100, 100 ]
+      size: [ 50, 50 ]
+    - surface-title: calendar
+      position: [ 200, 200 ]
+      size: [ 60, 60 ]
+    - surface-title: clock
+      position: [ 300, 300 ]
+      size: [ 70, 70 ]
+)", runner))
+    {
+        display_config.operator()(server);
+    }
+
+    miral::DisplayConfiguration get_display_config() override
+    {
+        return display_config;
+    }
+
+    miral::DisplayConfiguration display_config;
+};
+
+TEST_F(FrameWindowManagerWithSeveralTilesInDisplayConfig, WindowsArePlacedByTheirTitlesTile)
+{
+    auto const app = open_application("test");
+    miral::WindowSpecification spec;
+    spec.name() = "calendar";
+    auto const window = create_window(app, spec);
+    EXPECT_THAT(window.top_left(), Eq(geom::Point{200, 200}));
+    EXPECT_THAT(window.size(), Eq(geom::Size{60, 60}));
+}
+
+TEST_F(FrameWindowManagerWithSeveralTilesInDisplayConfig, TheFirstTileForATitleIsUsed)
+{
+    auto const app = open_application("test");
+    miral::WindowSpecification spec;
+    spec.name() = "clock";
+    auto const window = create_window(app, spec);
+    EXPECT_THAT(window.top_left(), Eq(geom::Point{100, 100}));
+    EXPECT_THAT(window.size(), Eq(geom::Size{50, 50}));
+}
+
+class FrameWindowManagerWithTwoLayoutsOfTheSameCards : public FrameWindowManagerTest
+{
+protected:
+    FrameWindowManagerWithTwoLayoutsOfTheSameCards()
+        : display_config(write_and_build_display_config(
+            "/tmp/test.display",
+            R"(
+layouts:
+  default:
+    cards:
+    - card-id: 0
+      VGA-1:
+        state: enabled
+        mode: 800x600@60.0
+    applications:
+    - surface-title: test
+      position: [ 100, 100 ]
+      size: [ 50, 50 ]
+  alternative:
+    cards:
+    - card-id: 0
+      VGA-1:
+        state: enabled
+        mode: 800x600@60.0
+    applications:
+    - surface-title: test
+      position: [ 200, 200 ]
+      size: [ 60, 60 ]
+)", runner))
+    {
+        display_config.operator()(server);
+    }
+
+    miral::DisplayConfiguration get_display_config() override
+    {
+        return display_config;
+    }
+
+    miral::DisplayConfiguration display_config;
+};
+
+TEST_F(FrameWindowManagerWithTwoLayoutsOfTheSameCards, NewWindowsArePlacedByTheSelectedLayout)
+{
+    auto const app = open_application("test");
+    miral::WindowSpecification spec;
+    spec.name() = "test";
+
+    auto const first = create_window(app, spec);
+    EXPECT_THAT(first.top_left(), Eq(geom::Point{100, 100}));
+
+    // Selecting a layout with the same cards changes no output
+    display_config.select_layout("alternative");
+
+    auto const second = create_window(app, spec);
+    EXPECT_THAT(second.top_left(), Eq(geom::Point{200, 200}));
+    EXPECT_THAT(second.size(), Eq(geom::Size{60, 60}));
+}
+
+namespace
+{
+auto constexpr SECOND_DISPLAY_RECT = geom::Rectangle({800, 0}, {800, 600});
+}
+
+class FrameWindowManagerWithOutputClaimsInDisplayConfig : public FrameWindowManagerTest
+{
+protected:
+    FrameWindowManagerWithOutputClaimsInDisplayConfig()
+        : display_config(write_and_build_display_config(
+            "/tmp/test.display",
+            R"(
+layouts:
+  default:
+    cards:
+    - card-id: 0
+      VGA-1:
+        position: [0, 0]
+      VGA-2:
+        position: [800, 0]
+        surface-title: claimed
+)", runner))
+    {
+        display_config.operator()(server);
+    }
+
+    miral::DisplayConfiguration get_display_config() override
+    {
+        return display_config;
+    }
+
+    /// Moves the window within the first output, away from where a relayout would put it
+    void nudge(miral::Window const& window)
+    {
+        miral::WindowSpecification spec;
+        spec.top_left() = geom::Point{10, 10};
+        spec.size() = geom::Size{100, 100};
+        tools().modify_window(tools().info_for(window), spec);
+    }
+
+    miral::DisplayConfiguration display_config;
+};
+
+TEST_F(FrameWindowManagerWithOutputClaimsInDisplayConfig, HotpluggingAnOutputLeavesWindowsOnOtherOutputsUntouched)
+{
+    auto const app = open_application("test");
+    auto const window = create_window(app, miral::WindowSpecification{});
+    nudge(window);
+
+    update_outputs(output_configs_from_output_rectangles({DISPLAY_RECT, SECOND_DISPLAY_RECT}));
+
+    EXPECT_THAT(window.top_left(), Eq(geom::Point{10, 10}));
+    EXPECT_THAT(window.size(), Eq(geom::Size{100, 100}));
+}
+
+TEST_F(FrameWindowManagerWithOutputClaimsInDisplayConfig, AWindowAnOutputNewlyClaimsIsMovedOntoIt)
+{
+    auto const app = open_application("test");
+    miral::WindowSpecification spec;
+    spec.name() = "claimed";
+    auto const window = create_window(app, spec);
+    ASSERT_THAT(window.top_left(), Eq(DISPLAY_RECT.top_left));
+
+    update_outputs(output_configs_from_output_rectangles({DISPLAY_RECT, SECOND_DISPLAY_RECT}));
+
+    EXPECT_THAT(window.top_left(), Eq(SECOND_DISPLAY_RECT.top_left));
+    EXPECT_THAT(window.size(), Eq(SECOND_DISPLAY_RECT.size));
+}
+
+TEST_F(FrameWindowManagerWithOutputClaimsInDisplayConfig, WindowsOnADeletedOutputAreRelaidOut)
+{
+    update_outputs(output_configs_from_output_rectangles({DISPLAY_RECT, SECOND_DISPLAY_RECT}));
+    auto const app = open_application("test");
+    miral::WindowSpecification spec;
+    spec.name() = "claimed";
+    auto const window = create_window(app, spec);
+    ASSERT_THAT(window.top_left(), Eq(SECOND_DISPLAY_RECT.top_left));
+
+    update_outputs(output_configs_from_output_rectangles({DISPLAY_RECT}));
+
+    EXPECT_THAT(window.top_left(), Eq(DISPLAY_RECT.top_left));
+    EXPECT_THAT(window.size(), Eq(DISPLAY_RECT.size));
+}
+
+TEST_F(FrameWindowManagerWithOutputClaimsInDisplayConfig, AZoneChangeOnlyTouchesFullscreenWindowsOnTheOutputsItOverlaps)
+{
+    update_outputs(output_configs_from_output_rectangles({DISPLAY_RECT, SECOND_DISPLAY_RECT}));
+    auto const app = open_application("test");
+    auto const unclaimed = create_window(app, miral::WindowSpecification{});
+    nudge(unclaimed);
+    miral::WindowSpecification spec;
+    spec.name() = "claimed";
+    auto const claimed = create_window(app, spec);
+
+    geom::Rectangle const resized_second_display{SECOND_DISPLAY_RECT.top_left, {1024, 768}};
+    update_outputs(output_configs_from_output_rectangles({DISPLAY_RECT, resized_second_display}));
+
+    EXPECT_THAT(tools().info_for(unclaimed).state(), Eq(mir_window_state_fullscreen));
+    EXPECT_THAT(unclaimed.top_left(), Eq(geom::Point{10, 10}));
+    EXPECT_THAT(unclaimed.size(), Eq(geom::Size{100, 100}));
+    EXPECT_THAT(claimed.top_left(), Eq(resized_second_display.top_left));
+    EXPECT_THAT(claimed.size(), Eq(resized_second_display.size));
+}
+
+TEST_F(FrameWindowManagerWithOutputClaimsInDisplayConfig, AnOutputGrowingUnderAWindowOnItsNeighbourRelaysItOut)
+{
+    update_outputs(output_configs_from_output_rectangles({DISPLAY_RECT, SECOND_DISPLAY_RECT}));
+    auto const app = open_application("test");
+    auto const window = create_window(app, miral::WindowSpecification{});
+    miral::WindowSpecification spec;
+    spec.top_left() = SECOND_DISPLAY_RECT.top_left + geom::Displacement{10, 10};
+    spec.size() = geom::Size{100, 100};
+    tools().modify_window(tools().info_for(window), spec);
+
+    geom::Rectangle const grown_display{DISPLAY_RECT.top_left, {1600, 600}};
+    update_outputs(output_configs_from_output_rectangles({grown_display, SECOND_DISPLAY_RECT}));
+
+    EXPECT_THAT(tools().info_for(window).state(), Eq(mir_window_state_fullscreen));
+    EXPECT_THAT(window.size(), Ne(geom::Size{100, 100}));
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "layout_metadata.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace testing;
+namespace geom = mir::geometry;
+
+namespace
+{
+using Placement = LayoutMetadata::LayoutApplicationPlacementStrategy;
+
+auto by_snap(std::string const& snap_name, geom::Point position) -> Placement
+{
+    return {snap_name, std::nullopt, position, {50, 50}};
+}
+
+auto by_title(std::string const& title, geom::Point position) -> Placement
+{
+    return {std::nullopt, title, position, {50, 50}};
+}
+
+struct LayoutMetadataTest : Test
+{
+    LayoutMetadata const layout{{
+        by_title("clock", {0, 0}),
+        by_snap("mir-kiosk-kodi", {100, 0}),
+        by_title("calendar", {200, 0}),
+        by_snap("wpe-webkit-mir-kiosk", {300, 0}),
+        by_title("clock", {400, 0}),
+    }};
+
+    // Where layout places a window, if anywhere
+    auto placement_of(mir::optional_value<std::string> const& title, std::string_view snap_name) const
+        -> std::optional<geom::Point>
+    {
+        miral::WindowSpecification specification;
+        if (!layout.try_layout(specification, title, snap_name))
+            return std::nullopt;
+
+        EXPECT_THAT(specification.state().value(), Eq(mir_window_state_fullscreen));
+        EXPECT_THAT(specification.size().value(), Eq(geom::Size{50, 50}));
+        return specification.top_left().value();
+    }
+};
+}
+
+TEST_F(LayoutMetadataTest, places_windows_by_title)
+{
+    EXPECT_THAT(placement_of(std::string{"calendar"}, ""), Optional(geom::Point{200, 0}));
+}
+
+TEST_F(LayoutMetadataTest, places_windows_by_snap_name)
+{
+    EXPECT_THAT(placement_of({}, "wpe-webkit-mir-kiosk"), Optional(geom::Point{300, 0}));
+}
+
+TEST_F(LayoutMetadataTest, the_first_application_for_a_title_is_used)
+{
+    EXPECT_THAT(placement_of(std::string{"clock"}, ""), Optional(geom::Point{0, 0}));
+}
+
+TEST_F(LayoutMetadataTest, when_title_and_snap_name_both_match_the_earlier_application_is_used)
+{
+    EXPECT_THAT(placement_of(std::string{"calendar"}, "mir-kiosk-kodi"), Optional(geom::Point{100, 0}));
+    EXPECT_THAT(placement_of(std::string{"clock"}, "mir-kiosk-kodi"), Optional(geom::Point{0, 0}));
+}
+
+TEST_F(LayoutMetadataTest, a_window_without_a_title_is_not_matched_by_title)
+{
+    EXPECT_THAT(placement_of({}, ""), Eq(std::nullopt));
+    EXPECT_THAT(placement_of(std::string{"terminal"}, "gnome-terminal"), Eq(std::nullopt));
+}
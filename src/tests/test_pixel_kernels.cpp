@@ -0,0 +1,202 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "background_client.h"
+#include "pixel_kernels.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+// The gradient formula BackgroundClient::render_background has always used
+auto reference_gradient(uint32_t width, uint32_t height, Colour const& bottom, Colour const& top)
+    -> std::vector<unsigned char>
+{
+    std::vector<unsigned char> result;
+    result.reserve(4 * width * height);
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < width; x++)
+        {
+            for (auto i = 0; i < 3; i++)
+            {
+                result.push_back((y * bottom[i] + (height - y) * top[i]) / height);
+            }
+            result.push_back(0xFF);
+        }
+    }
+
+    return result;
+}
+
+// The per-pixel blend TextRenderer::render_glyph() has always used
+void reference_blend(uint32_t* dest, unsigned char const* coverage, size_t count, Colour const& colour)
+{
+    for (size_t i = 0; i != count; ++i)
+    {
+        unsigned char const alpha = (coverage[i] * colour[3]) / 255;
+        auto* const pixel = reinterpret_cast<unsigned char*>(dest + i);
+        for (int c = 0; c < 3; c++)
+        {
+            pixel[c] = (pixel[c] * (255 - alpha)) / 255 + (colour[c] * alpha) / 255;
+        }
+    }
+}
+}
+
+TEST(FillPixels, fills_exactly_the_requested_span)
+{
+    uint32_t const sentinel = 0xdeadbeef;
+    uint32_t const pixel = 0xff102030;
+
+    for (size_t offset = 0; offset != 8; ++offset)
+    {
+        for (size_t count = 0; count != 80; ++count)
+        {
+            std::vector<uint32_t> buffer(offset + count + 8, sentinel);
+
+            fill_pixels(buffer.data() + offset, count, pixel);
+
+            for (size_t i = 0; i != buffer.size(); ++i)
+            {
+                bool const inside = i >= offset && i < offset + count;
+                ASSERT_THAT(buffer[i], Eq(inside ? pixel : sentinel))
+                    << "offset=" << offset << " count=" << count << " i=" << i
+                    << " implementation=" << fill_pixels_implementation();
+            }
+        }
+    }
+}
+
+TEST(RenderBackground, gradient_matches_reference)
+{
+    Colour const top = {127, 127, 127, 255};
+    Colour const bottom = {31, 200, 0, 255};
+
+    std::vector<std::pair<uint32_t, uint32_t>> const sizes{{1, 1}, {7, 3}, {33, 255}, {64, 1000}};
+
+    for (auto const& [width, height] : sizes)
+    {
+        std::vector<unsigned char> buffer(4 * width * height);
+        BackgroundClient::render_background(width, height, buffer.data(), bottom, top);
+
+        EXPECT_THAT(buffer, Eq(reference_gradient(width, height, bottom, top)))
+            << width << "x" << height;
+    }
+}
+
+TEST(RenderBackground, bands_of_rows_match_the_whole_gradient)
+{
+    Colour const top = {127, 127, 127, 255};
+    Colour const bottom = {31, 200, 0, 255};
+    uint32_t const width = 9;
+    uint32_t const height = 1000;
+
+    for (uint32_t const bands : {1u, 2u, 3u, 7u, 64u})
+    {
+        std::vector<unsigned char> buffer(4 * width * height);
+        for (uint32_t band = 0; band != bands; ++band)
+        {
+            BackgroundClient::render_background_rows(
+                width, height, buffer.data(), bottom, top, height * band / bands, height * (band + 1) / bands);
+        }
+
+        EXPECT_THAT(buffer, Eq(reference_gradient(width, height, bottom, top))) << bands << " bands";
+    }
+}
+
+TEST(RenderBackground, solid_colour_matches_reference)
+{
+    Colour const colour = {36, 12, 56, 255};
+    uint32_t const width = 17;
+    uint32_t const height = 5;
+
+    std::vector<unsigned char> buffer(4 * width * height);
+    BackgroundClient::render_background(width, height, buffer.data(), colour);
+
+    EXPECT_THAT(buffer, Eq(reference_gradient(width, height, colour, colour)));
+}
+
+TEST(BlendCoverage, matches_reference_for_every_coverage_and_destination)
+{
+    Colour const colours[]{{0, 0, 0, 255}, {255, 255, 255, 255}, {36, 12, 56, 255}, {200, 100, 1, 128}};
+
+    // Every coverage value against every destination value, with some zero coverage runs thrown in
+    std::vector<unsigned char> coverage(256 + 19, 0);
+    for (int i = 0; i != 256; ++i)
+    {
+        coverage[i] = static_cast<unsigned char>(i);
+    }
+
+    for (auto const& colour : colours)
+    {
+        uint32_t colour_pixel;
+        memcpy(&colour_pixel, colour, sizeof(colour_pixel));
+
+        for (int destination = 0; destination != 256; ++destination)
+        {
+            std::vector<uint32_t> buffer(coverage.size());
+            for (size_t i = 0; i != buffer.size(); ++i)
+            {
+                unsigned char const bytes[4]{
+                    static_cast<unsigned char>(destination),
+                    static_cast<unsigned char>(255 - destination),
+                    static_cast<unsigned char>(destination ^ 0x5a),
+                    static_cast<unsigned char>(i)};
+                memcpy(&buffer[i], bytes, sizeof(bytes));
+            }
+            auto expected = buffer;
+
+            reference_blend(expected.data(), coverage.data(), coverage.size(), colour);
+            blend_coverage(buffer.data(), coverage.data(), coverage.size(), colour_pixel);
+
+            ASSERT_THAT(buffer, Eq(expected))
+                << "destination=" << destination << " implementation=" << blend_coverage_implementation();
+        }
+    }
+}
+
+TEST(BlendCoverage, blends_exactly_the_requested_span)
+{
+    uint32_t const sentinel = 0xdeadbeef;
+    uint32_t const colour = 0xff102030;
+    std::vector<unsigned char> const coverage(80, 0xff);
+
+    for (size_t offset = 0; offset != 8; ++offset)
+    {
+        for (size_t count = 0; count != 64; ++count)
+        {
+            std::vector<uint32_t> buffer(offset + count + 8, sentinel);
+
+            blend_coverage(buffer.data() + offset, coverage.data() + offset, count, colour);
+
+            for (size_t i = 0; i != buffer.size(); ++i)
+            {
+                bool const inside = i >= offset && i < offset + count;
+                ASSERT_THAT(buffer[i], Eq(inside ? 0xde102030 : sentinel))
+                    << "offset=" << offset << " count=" << count << " i=" << i
+                    << " implementation=" << blend_coverage_implementation();
+            }
+        }
+    }
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "placement_mapping.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace testing;
+using egmde::PlacementMapping;
+
+TEST(PlacementMapping, finds_the_output_claiming_a_title_or_snap)
+{
+    PlacementMapping mapping;
+    mapping.update(1, "clock", std::nullopt);
+    mapping.update(2, std::nullopt, "wpe-webkit-mir-kiosk");
+
+    EXPECT_THAT(mapping.output_for_surface("clock"), Optional(1));
+    EXPECT_THAT(mapping.output_for_snap("wpe-webkit-mir-kiosk"), Optional(2));
+    EXPECT_THAT(mapping.output_for_surface("wpe-webkit-mir-kiosk"), Eq(std::nullopt));
+    EXPECT_THAT(mapping.output_for_snap("clock"), Eq(std::nullopt));
+}
+
+TEST(PlacementMapping, update_replaces_what_the_output_claimed)
+{
+    PlacementMapping mapping;
+    mapping.update(1, "clock", "mir-kiosk-kodi");
+
+    mapping.update(1, "calendar", std::nullopt);
+
+    EXPECT_THAT(mapping.output_for_surface("clock"), Eq(std::nullopt));
+    EXPECT_THAT(mapping.output_for_snap("mir-kiosk-kodi"), Eq(std::nullopt));
+    EXPECT_THAT(mapping.output_for_surface("calendar"), Optional(1));
+}
+
+TEST(PlacementMapping, clear_drops_only_that_outputs_claims)
+{
+    PlacementMapping mapping;
+    mapping.update(1, "clock", "mir-kiosk-kodi");
+    mapping.update(2, "calendar", "wpe-webkit-mir-kiosk");
+
+    mapping.clear(1);
+
+    EXPECT_THAT(mapping.output_for_surface("clock"), Eq(std::nullopt));
+    EXPECT_THAT(mapping.output_for_snap("mir-kiosk-kodi"), Eq(std::nullopt));
+    EXPECT_THAT(mapping.output_for_surface("calendar"), Optional(2));
+    EXPECT_THAT(mapping.output_for_snap("wpe-webkit-mir-kiosk"), Optional(2));
+}
+
+TEST(PlacementMapping, first_output_to_claim_a_name_keeps_it)
+{
+    PlacementMapping mapping;
+    mapping.update(3, "clock", std::nullopt);
+    mapping.update(1, "clock", std::nullopt);
+    mapping.update(2, "clock", std::nullopt);
+
+    EXPECT_THAT(mapping.output_for_surface("clock"), Optional(3));
+
+    mapping.clear(3);
+    EXPECT_THAT(mapping.output_for_surface("clock"), Optional(1));
+
+    // Updating an output makes it the latest claimant
+    mapping.update(1, "clock", std::nullopt);
+    EXPECT_THAT(mapping.output_for_surface("clock"), Optional(2));
+}
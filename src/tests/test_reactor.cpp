@@ -0,0 +1,169 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "reactor.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+using namespace testing;
+using namespace std::chrono_literals;
+using egmde::Reactor;
+
+namespace
+{
+struct ReactorTest : Test
+{
+    Reactor reactor;
+    mir::Fd const event{eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)};
+};
+}
+
+TEST_F(ReactorTest, calls_handler_when_fd_is_ready)
+{
+    int calls = 0;
+    reactor.add_fd(event, EPOLLIN | EPOLLET, [&](uint32_t events)
+        {
+            EXPECT_THAT(events & EPOLLIN, Ne(0u));
+            ++calls;
+        });
+
+    reactor.dispatch(0ms);
+    EXPECT_THAT(calls, Eq(0));
+
+    eventfd_write(event, 1);
+    reactor.dispatch(0ms);
+    EXPECT_THAT(calls, Eq(1));
+}
+
+TEST_F(ReactorTest, edge_triggered_handler_is_called_once_per_change)
+{
+    int calls = 0;
+    reactor.add_fd(event, EPOLLIN | EPOLLET, [&](uint32_t) { ++calls; });
+
+    eventfd_write(event, 1);
+    reactor.dispatch(0ms);
+    reactor.dispatch(0ms);
+
+    EXPECT_THAT(calls, Eq(1));
+}
+
+TEST_F(ReactorTest, removed_fd_is_not_handled)
+{
+    int calls = 0;
+    reactor.add_fd(event, EPOLLIN, [&](uint32_t) { ++calls; });
+    reactor.remove_fd(event);
+
+    eventfd_write(event, 1);
+    reactor.dispatch(0ms);
+
+    EXPECT_THAT(calls, Eq(0));
+}
+
+TEST_F(ReactorTest, timer_is_not_armed_until_asked)
+{
+    Reactor::Timer timer{reactor, [] {}};
+
+    EXPECT_THAT(timer.remaining(), Eq(std::nullopt));
+}
+
+TEST_F(ReactorTest, armed_timer_reports_time_remaining)
+{
+    Reactor::Timer timer{reactor, [] {}};
+
+    timer.arm(10s);
+
+    auto const remaining = timer.remaining();
+    ASSERT_THAT(remaining, Ne(std::nullopt));
+    EXPECT_THAT(*remaining, AllOf(Gt(9s), Le(10s)));
+}
+
+TEST_F(ReactorTest, timer_fires_once_after_its_delay)
+{
+    int calls = 0;
+    Reactor::Timer timer{reactor, [&] { ++calls; }};
+    auto const start = std::chrono::steady_clock::now();
+
+    timer.arm(20ms);
+    reactor.dispatch(0ms);
+    EXPECT_THAT(calls, Eq(0));
+
+    while (calls == 0 && std::chrono::steady_clock::now() - start < 1s)
+    {
+        reactor.dispatch(100ms);
+    }
+
+    EXPECT_THAT(calls, Eq(1));
+    EXPECT_THAT(std::chrono::steady_clock::now() - start, Ge(20ms));
+    EXPECT_THAT(timer.remaining(), Eq(std::nullopt));
+
+    reactor.dispatch(50ms);
+    EXPECT_THAT(calls, Eq(1));
+}
+
+TEST_F(ReactorTest, zero_delay_timer_fires_straight_away)
+{
+    int calls = 0;
+    Reactor::Timer timer{reactor, [&] { ++calls; }};
+
+    timer.arm(0ms);
+    reactor.dispatch(100ms);
+
+    EXPECT_THAT(calls, Eq(1));
+}
+
+TEST_F(ReactorTest, disarmed_timer_does_not_fire)
+{
+    int calls = 0;
+    Reactor::Timer timer{reactor, [&] { ++calls; }};
+
+    timer.arm(0ms);
+    timer.disarm();
+    reactor.dispatch(50ms);
+
+    EXPECT_THAT(calls, Eq(0));
+    EXPECT_THAT(timer.remaining(), Eq(std::nullopt));
+}
+
+TEST_F(ReactorTest, rearming_replaces_the_expiry)
+{
+    int calls = 0;
+    Reactor::Timer timer{reactor, [&] { ++calls; }};
+
+    timer.arm(0ms);
+    timer.arm(10s);
+    reactor.dispatch(50ms);
+
+    EXPECT_THAT(calls, Eq(0));
+    EXPECT_THAT(timer.remaining(), Ne(std::nullopt));
+}
+
+TEST_F(ReactorTest, timer_can_fire_repeatedly)
+{
+    int calls = 0;
+    Reactor::Timer timer{reactor, [&] { ++calls; }};
+
+    for (auto i = 0; i != 3; ++i)
+    {
+        timer.arm(0ms);
+        reactor.dispatch(100ms);
+    }
+
+    EXPECT_THAT(calls, Eq(3));
+}
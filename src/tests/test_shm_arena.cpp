@@ -0,0 +1,178 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "shm_arena.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+using namespace testing;
+using egmde::ArenaRanges;
+using egmde::ShmArena;
+
+namespace
+{
+struct ArenaRangesTest : Test
+{
+    ArenaRanges ranges;
+};
+}
+
+TEST_F(ArenaRangesTest, an_empty_arena_has_nothing_to_allocate)
+{
+    EXPECT_THAT(ranges.allocate(1), Eq(std::nullopt));
+    EXPECT_THAT(ranges.shortfall(100), Eq(128u));
+}
+
+TEST_F(ArenaRangesTest, allocations_are_aligned_and_do_not_overlap)
+{
+    ranges.grow(1024);
+
+    auto const first = ranges.allocate(100);
+    auto const second = ranges.allocate(1);
+
+    ASSERT_THAT(first, Ne(std::nullopt));
+    ASSERT_THAT(second, Ne(std::nullopt));
+    EXPECT_THAT(*first % ArenaRanges::alignment, Eq(0u));
+    EXPECT_THAT(*second % ArenaRanges::alignment, Eq(0u));
+    EXPECT_THAT(*second, Ge(*first + 100));
+    EXPECT_THAT(ranges.allocated_bytes(), Eq(128u + 64u));
+    EXPECT_THAT(ranges.allocation_count(), Eq(2u));
+}
+
+TEST_F(ArenaRangesTest, a_freed_range_is_reused)
+{
+    ranges.grow(256);
+
+    auto const first = ranges.allocate(128);
+    ranges.allocate(128);
+    EXPECT_THAT(ranges.allocate(64), Eq(std::nullopt));
+
+    ranges.free(*first);
+
+    EXPECT_THAT(ranges.allocate(64), Eq(first));
+}
+
+TEST_F(ArenaRangesTest, freed_neighbours_are_merged)
+{
+    ranges.grow(3 * 64);
+
+    auto const a = ranges.allocate(64);
+    auto const b = ranges.allocate(64);
+    auto const c = ranges.allocate(64);
+
+    ranges.free(*a);
+    ranges.free(*c);
+    EXPECT_THAT(ranges.largest_free_range(), Eq(64u));
+
+    ranges.free(*b);
+    EXPECT_THAT(ranges.largest_free_range(), Eq(3 * 64u));
+    EXPECT_THAT(ranges.allocate(3 * 64), Eq(a));
+}
+
+TEST_F(ArenaRangesTest, growing_extends_a_free_range_at_the_end)
+{
+    ranges.grow(256);
+    ranges.allocate(128);
+
+    EXPECT_THAT(ranges.shortfall(256), Eq(128u));
+
+    ranges.grow(ranges.capacity() + ranges.shortfall(256));
+
+    EXPECT_THAT(ranges.capacity(), Eq(384u));
+    EXPECT_THAT(ranges.allocate(256), Eq(128u));
+}
+
+TEST_F(ArenaRangesTest, freeing_an_unallocated_range_throws)
+{
+    ranges.grow(256);
+
+    EXPECT_THROW(ranges.free(0), std::logic_error);
+}
+
+namespace
+{
+auto constexpr mib = size_t{1024 * 1024};
+
+struct ShmArenaTest : Test
+{
+    // No wl_shm: the arena maps memory without creating pools for a compositor to share
+    ShmArena arena{nullptr, 4 * mib};
+};
+}
+
+TEST_F(ShmArenaTest, allocations_can_be_written)
+{
+    auto const a = arena.allocate(mib);
+    auto const b = arena.allocate(mib);
+
+    std::fill_n(arena.data(a), mib, 0xaa);
+    std::fill_n(arena.data(b), mib, 0xbb);
+
+    EXPECT_THAT(arena.data(a)[mib - 1], Eq(0xaa));
+    EXPECT_THAT(arena.data(b)[0], Eq(0xbb));
+    EXPECT_THAT(arena.stats().live_allocations, Eq(2u));
+    EXPECT_THAT(arena.stats().bytes_allocated, Eq(2 * mib));
+}
+
+TEST_F(ShmArenaTest, grows_by_at_least_half_again)
+{
+    arena.allocate(mib);
+    auto const first_capacity = arena.stats().bytes_mapped;
+
+    arena.allocate(64);
+
+    EXPECT_THAT(arena.stats().bytes_mapped, Ge(first_capacity + first_capacity / 2));
+
+    // So the next few allocations fit without growing again
+    auto const grown_capacity = arena.stats().bytes_mapped;
+    arena.allocate(64);
+    arena.allocate(64);
+    EXPECT_THAT(arena.stats().bytes_mapped, Eq(grown_capacity));
+}
+
+TEST_F(ShmArenaTest, moves_to_a_fresh_pool_when_mostly_free)
+{
+    auto const large = arena.allocate(16 * mib);
+    auto const small = arena.allocate(mib);
+
+    arena.free(large);
+
+    EXPECT_TRUE(arena.has_stale_pools());
+    EXPECT_TRUE(arena.is_stale(small));
+
+    auto const replacement = arena.allocate(mib);
+    EXPECT_FALSE(arena.is_stale(replacement));
+    EXPECT_THAT(arena.stats().pools, Eq(2u));
+
+    arena.free(small);
+
+    EXPECT_FALSE(arena.has_stale_pools());
+    EXPECT_THAT(arena.stats().pools, Eq(1u));
+    EXPECT_THAT(arena.stats().bytes_mapped, Lt(16 * mib));
+}
+
+TEST_F(ShmArenaTest, keeps_a_pool_with_little_to_reclaim)
+{
+    auto const a = arena.allocate(2 * mib);
+    arena.allocate(64);
+
+    arena.free(a);
+
+    EXPECT_FALSE(arena.has_stale_pools());
+}
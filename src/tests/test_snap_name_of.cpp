@@ -0,0 +1,124 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "snap_name_of.h"
+
+#include <mir/test/doubles/stub_session.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace testing;
+namespace mtd = mir::test::doubles;
+using egmde::SnapIdentity;
+using egmde::SnapIdentityCache;
+using egmde::snap_identity_from;
+
+TEST(SnapIdentity, is_read_from_an_apparmor_label)
+{
+    auto const identity = snap_identity_from("snap.ubuntu-frame-osk.daemon", "snap.", '.');
+
+    EXPECT_THAT(identity.snap_name, Eq("ubuntu-frame-osk"));
+    EXPECT_THAT(identity.instance_name, Eq("ubuntu-frame-osk"));
+}
+
+TEST(SnapIdentity, snap_name_drops_the_parallel_install_suffix)
+{
+    auto const identity = snap_identity_from("snap.wpe-webkit-mir-kiosk_beta.browser", "snap.", '.');
+
+    EXPECT_THAT(identity.snap_name, Eq("wpe-webkit-mir-kiosk"));
+    EXPECT_THAT(identity.instance_name, Eq("wpe-webkit-mir-kiosk_beta"));
+}
+
+TEST(SnapIdentity, is_read_from_an_executable_path)
+{
+    auto const identity = snap_identity_from("/snap/mir-kiosk-kodi/123/usr/bin/kodi", "/snap/", '/');
+
+    EXPECT_THAT(identity.snap_name, Eq("mir-kiosk-kodi"));
+    EXPECT_THAT(identity.instance_name, Eq("mir-kiosk-kodi"));
+}
+
+TEST(SnapIdentity, is_empty_for_anything_else)
+{
+    EXPECT_THAT(snap_identity_from("unconfined", "snap.", '.').snap_name, Eq(""));
+    EXPECT_THAT(snap_identity_from("/usr/bin/kodi", "/snap/", '/').instance_name, Eq(""));
+}
+
+namespace
+{
+struct SnapIdentityCacheTest : Test
+{
+    std::optional<SnapIdentity> result = SnapIdentity{"kodi", "kodi_1"};
+    int identifications = 0;
+
+    SnapIdentityCache cache{[this](miral::Application const&)
+        {
+            ++identifications;
+            return result;
+        }};
+
+    miral::Application const app = std::make_shared<mtd::StubSession>();
+};
+}
+
+TEST_F(SnapIdentityCacheTest, identifies_each_app_once)
+{
+    EXPECT_THAT(cache.identity_of(app).instance_name, Eq("kodi_1"));
+    EXPECT_THAT(cache.identity_of(app).snap_name, Eq("kodi"));
+
+    EXPECT_THAT(identifications, Eq(1));
+}
+
+TEST_F(SnapIdentityCacheTest, keeps_the_label_an_app_was_identified_by)
+{
+    result = SnapIdentity{"kodi", "kodi_1", false, "snap.kodi_1.kodi"};
+
+    cache.identity_of(app);
+
+    EXPECT_THAT(cache.identity_of(app).label, Eq("snap.kodi_1.kodi"));
+    EXPECT_THAT(identifications, Eq(1));
+}
+
+TEST_F(SnapIdentityCacheTest, identifies_an_app_again_once_forgotten)
+{
+    cache.identity_of(app);
+    cache.forget(app);
+
+    result = SnapIdentity{"kodi", "kodi_2"};
+
+    EXPECT_THAT(cache.identity_of(app).instance_name, Eq("kodi_2"));
+    EXPECT_THAT(identifications, Eq(2));
+}
+
+TEST_F(SnapIdentityCacheTest, failures_to_identify_are_not_kept)
+{
+    result = std::nullopt;
+    EXPECT_THAT(cache.identity_of(app).snap_name, Eq(""));
+
+    result = SnapIdentity{"kodi", "kodi"};
+    EXPECT_THAT(cache.identity_of(app).snap_name, Eq("kodi"));
+    EXPECT_THAT(identifications, Eq(2));
+}
+
+TEST_F(SnapIdentityCacheTest, apps_are_identified_separately)
+{
+    miral::Application const other = std::make_shared<mtd::StubSession>();
+
+    cache.identity_of(app);
+    cache.identity_of(other);
+
+    EXPECT_THAT(identifications, Eq(2));
+}
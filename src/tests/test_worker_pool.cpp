@@ -0,0 +1,122 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "worker_pool.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+using namespace testing;
+using egmde::WorkerPool;
+
+namespace
+{
+auto counting_jobs(std::vector<std::atomic<int>>& counts) -> std::vector<std::function<void()>>
+{
+    std::vector<std::function<void()>> jobs;
+    for (auto& count : counts)
+    {
+        jobs.push_back([&count] { ++count; });
+    }
+    return jobs;
+}
+}
+
+TEST(WorkerPool, runs_every_job_once)
+{
+    WorkerPool pool{3};
+    std::vector<std::atomic<int>> counts(100);
+
+    pool.run(counting_jobs(counts));
+
+    for (auto const& count : counts)
+    {
+        EXPECT_THAT(count.load(), Eq(1));
+    }
+}
+
+TEST(WorkerPool, without_workers_runs_jobs_on_the_caller)
+{
+    WorkerPool pool{0};
+    auto const caller = std::this_thread::get_id();
+    std::vector<std::thread::id> ran_on(5);
+
+    std::vector<std::function<void()>> jobs;
+    for (auto& id : ran_on)
+    {
+        jobs.push_back([&id] { id = std::this_thread::get_id(); });
+    }
+    pool.run(jobs);
+
+    EXPECT_THAT(pool.concurrency(), Eq(1u));
+    EXPECT_THAT(ran_on, Each(Eq(caller)));
+}
+
+TEST(WorkerPool, jobs_run_in_parallel)
+{
+    WorkerPool pool{1};
+    std::atomic<int> arrived{0};
+
+    // Each job waits for the other, so this only finishes if both run at once
+    auto const rendezvous = [&arrived]
+        {
+            ++arrived;
+            while (arrived < 2)
+            {
+                std::this_thread::yield();
+            }
+        };
+
+    pool.run({rendezvous, rendezvous});
+
+    EXPECT_THAT(arrived.load(), Eq(2));
+}
+
+TEST(WorkerPool, rethrows_a_failed_job_after_the_others_finish)
+{
+    WorkerPool pool{2};
+    std::vector<std::atomic<int>> counts(20);
+    auto jobs = counting_jobs(counts);
+    jobs.insert(jobs.begin(), [] { throw std::runtime_error{"job failed"}; });
+
+    EXPECT_THROW(pool.run(jobs), std::runtime_error);
+
+    for (auto const& count : counts)
+    {
+        EXPECT_THAT(count.load(), Eq(1));
+    }
+}
+
+TEST(WorkerPool, can_be_reused)
+{
+    WorkerPool pool{2};
+    std::vector<std::atomic<int>> counts(10);
+    auto const jobs = counting_jobs(counts);
+
+    for (auto i = 0; i != 3; ++i)
+    {
+        pool.run(jobs);
+    }
+
+    for (auto const& count : counts)
+    {
+        EXPECT_THAT(count.load(), Eq(3));
+    }
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+egmde::WorkerPool::WorkerPool(unsigned workers)
+{
+    threads.reserve(workers);
+    for (unsigned i = 0; i != workers; ++i)
+    {
+        threads.emplace_back([this] { work(); });
+    }
+}
+
+egmde::WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard lock{mutex};
+        stopping = true;
+    }
+    work_available.notify_all();
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+auto egmde::WorkerPool::default_workers() -> unsigned
+{
+    return std::max(std::thread::hardware_concurrency(), 1u) - 1;
+}
+
+void egmde::WorkerPool::run(std::vector<std::function<void()>> const& jobs)
+{
+    if (jobs.empty())
+    {
+        return;
+    }
+
+    std::unique_lock lock{mutex};
+
+    batch = &jobs;
+    next_job = 0;
+    failure = nullptr;
+
+    if (jobs.size() > 1)
+    {
+        work_available.notify_all();
+    }
+
+    run_jobs(lock);
+
+    // Wait for jobs other threads picked up, after which none of them can touch jobs
+    batch_done.wait(lock, [this] { return jobs_running == 0; });
+    batch = nullptr;
+
+    if (auto const error = std::exchange(failure, nullptr))
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+void egmde::WorkerPool::work()
+{
+    std::unique_lock lock{mutex};
+
+    while (true)
+    {
+        work_available.wait(lock, [this] { return stopping || (batch && next_job != batch->size()); });
+
+        if (stopping)
+        {
+            return;
+        }
+
+        run_jobs(lock);
+    }
+}
+
+void egmde::WorkerPool::run_jobs(std::unique_lock<std::mutex>& lock)
+{
+    while (batch && next_job != batch->size())
+    {
+        auto const& job = (*batch)[next_job++];
+        ++jobs_running;
+
+        lock.unlock();
+        std::exception_ptr error;
+        try
+        {
+            job();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        lock.lock();
+
+        if (error && !failure)
+        {
+            failure = error;
+        }
+
+        if (--jobs_running == 0)
+        {
+            batch_done.notify_all();
+        }
+    }
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright © Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_WORKER_POOL_H
+#define FRAME_WORKER_POOL_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace egmde
+{
+/// A fixed set of threads that run batches of independent jobs alongside the thread submitting them
+class WorkerPool
+{
+public:
+    /// \param workers the number of threads to start in addition to the caller of run() (which may be zero)
+    explicit WorkerPool(unsigned workers);
+    ~WorkerPool();
+
+    WorkerPool(WorkerPool const&) = delete;
+    WorkerPool& operator=(WorkerPool const&) = delete;
+
+    /// Runs every job, returning once all are done. If any throws, the first exception is rethrown here.
+    void run(std::vector<std::function<void()>> const& jobs);
+
+    /// The threads that run() can use: the workers and the caller
+    auto concurrency() const -> unsigned { return threads.size() + 1; }
+
+    /// One worker per core beyond the caller's
+    static auto default_workers() -> unsigned;
+
+private:
+    void work();
+    void run_jobs(std::unique_lock<std::mutex>& lock);
+
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable batch_done;
+
+    std::vector<std::function<void()>> const* batch = nullptr;
+    size_t next_job = 0;
+    size_t jobs_running = 0;
+    std::exception_ptr failure;
+    bool stopping = false;
+
+    std::vector<std::thread> threads;
+};
+}
+
+#endif //FRAME_WORKER_POOL_H